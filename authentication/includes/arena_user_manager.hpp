@@ -0,0 +1,139 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <optional>
+#include <string_view>
+
+#include "user.hpp"
+#include "user_manager.hpp"
+
+class ArenaUserManager;
+
+// User whose strings live in the arena of an ArenaUserManager, each one
+// taking only its length plus the terminator and a small block header.
+class ArenaUser : public User
+{
+    public:
+        ArenaUser();
+
+        void attach(ArenaUserManager& manager, uint32_t slot);
+
+        // Allocates the longest strings allowed, so they can be written in place.
+        ResultVoid reserve() override;
+
+        void applyPatch(const UserPatch& patch) override;
+
+    protected:
+        friend class ArenaUserManager;
+
+        ArenaUserManager* manager = nullptr;
+        uint32_t slot = 0;
+
+        uint32_t getOwner(StringField field) const;
+        // Called by the arena when it moves the block of a field.
+        void relocate(StringField field, char* data);
+
+        using StringValues = std::array<std::optional<std::string_view>, 3>;
+
+        ResultVoid setString(StringField field, std::string_view stringValue) override;
+        ResultVoid prepareString(StringField field, size_t length) override;
+
+        // The values may be strings of the arena, which compaction moves while the fields
+        // set first are allocated, so they're tracked. A value that is part of a string of
+        // this user that's set before it keeps that block until every value is copied.
+        ResultVoid setStrings(const StringValues& values);
+        // Data of every value, null for the fields that aren't set.
+        static std::array<const char*, 3> getSources(const StringValues& values);
+        // True when the source of a value set after the field points into its storage.
+        static bool isReferenced(StringField field, std::span<const char> storage, std::span<const char* const> sources);
+        ResultVoid checkStrings(const UserPatch& patch) const override;
+        void releaseStrings() override;
+};
+
+// User manager with a fixed byte budget for the strings of every user, instead
+// of the longest string allowed for each field of each user. Freed blocks are
+// reclaimed by compacting the arena when an allocation doesn't fit at the end.
+//
+// Block: Owner (4 bytes) | Size (2 bytes) | String, '\0'
+//
+// The owner is the slot of the user times 3 plus the field, so it fits any table.
+class ArenaUserManager : public UserManager
+{
+    public:
+        static constexpr size_t HeaderSize = 6;
+
+        // Every user must be an ArenaUser attached to this manager with its index.
+        ArenaUserManager(std::span<User*> usersStorage, std::span<char> arenaStorage,
+                         size_t usernameMaxLength, size_t passwordMaxLength, size_t nameMaxLength);
+        ArenaUserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                         std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage, std::span<char> arenaStorage,
+                         size_t usernameMaxLength, size_t passwordMaxLength, size_t nameMaxLength);
+
+        // Bytes that can still be allocated, counting the ones compaction would reclaim.
+        size_t getFreeBytes() const;
+
+    protected:
+        friend class ArenaUser;
+
+        static constexpr uint32_t FreeOwner = UINT32_MAX;
+        // Block of a previous string kept while a user sets its strings, see ArenaUser::setStrings.
+        static constexpr uint32_t RetainedOwner = UINT32_MAX - 1;
+
+        struct BlockHeader
+        {
+            uint32_t owner;
+            uint16_t size;
+        };
+
+        std::span<char> arena;
+        size_t used = 0;
+        // Bytes of freed blocks below used.
+        size_t released = 0;
+
+        // Length limits of each field, terminator included, like the storage sizes of StaticUser.
+        size_t usernameMaxLength;
+        size_t passwordMaxLength;
+        size_t nameMaxLength;
+
+        // Pointers that compaction moves along with the blocks holding them, while a user sets its strings.
+        std::span<const char*> trackedSources;
+
+        size_t getMaxLength(ArenaUser::StringField field) const;
+
+        Result<std::span<char>> allocate(uint32_t owner, size_t size);
+        // Keeps the first size bytes of the block, the rest is freed when it fits a header.
+        void shrink(std::span<char>& block, size_t size);
+        // Marks the block as not belonging to any field, it's moved but not relocated by compaction.
+        void retain(std::span<char> block);
+        void release(const char* block);
+        void compact();
+
+        BlockHeader readHeader(size_t offset) const;
+        void writeHeader(size_t offset, BlockHeader header);
+};
+
+template <size_t UsersAmount, size_t ArenaSize, size_t UsernameMaxLength, size_t PasswordMaxLength, size_t NameMaxLength>
+class StaticArenaUserManager : public ArenaUserManager
+{
+    protected:
+        std::array<ArenaUser, UsersAmount> usersStorage;
+        std::array<User*, UsersAmount> usersPointers;
+        std::array<User::IdType, UsersAmount> idsStorage;
+        std::array<Permission, UsersAmount> permissionsStorage;
+        std::array<SlotState, UsersAmount> statesStorage;
+        std::array<uint32_t, UsersAmount> usernameHashesStorage;
+        std::array<char, ArenaSize> arenaStorage;
+
+    public:
+        StaticArenaUserManager()
+            : ArenaUserManager(usersPointers, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage, arenaStorage,
+                               UsernameMaxLength, PasswordMaxLength, NameMaxLength)
+        {
+            for (size_t i = 0; i < UsersAmount; i++)
+            {
+                usersStorage[i].attach(*this, i);
+                usersPointers[i] = &usersStorage[i];
+            }
+        };
+};
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "authentication_errors.hpp"
+#include "authentication_metrics.hpp"
 
 #include "user.hpp"
 #include "user_manager.hpp"
 #include "session_manager.hpp"
+#include "login_throttle.hpp"
 
 #include <span>
 #include <string>
@@ -15,7 +17,8 @@ class Authentication
     public:
         Authentication(UserManager& userManager, SessionManager& sessionManager);
 
-        ResultSession authenticate(std::string_view username, std::string_view password);
+        // With a login throttle set, blocked usernames and channels fail with Throttled before the password is checked.
+        ResultSession authenticate(std::string_view username, std::string_view password, std::optional<LoginThrottle::ChannelId> channel = std::nullopt);
 
         ResultSession validate(Session::TokenType token);
 
@@ -27,7 +30,15 @@ class Authentication
         UserManager* getUserManager();
         SessionManager* getSessionManager();
 
+        // Optional, without one failed logins have no penalty.
+        void setLoginThrottle(LoginThrottle& throttle);
+
         Result<User::IdType> createUser(Session::TokenType token, Permission newPermission, std::string_view newUsername, std::string_view newPassword, std::string_view newName);
+        // Creates the user from a slot taken with UserManager::reserveUser, whose strings were already written.
+        Result<User::IdType> createUser(Session::TokenType token, Permission newPermission, User& reservedUser, size_t usernameLength, size_t passwordLength, size_t nameLength);
+
+        // Validates the token once for the whole batch, see UserManager::createUsers. Returns the amount created.
+        Result<size_t> createUsers(Session::TokenType token, std::span<const UserSpec> specs, std::span<ResultUser> results);
 
         ResultVoid deleteUser(Session::TokenType token, const User& user);
         ResultVoid deleteUser(Session::TokenType token, User::IdType userId);
@@ -43,7 +54,45 @@ class Authentication
         ResultVoid modifyName(Session::TokenType token, User::IdType id, std::string_view newName);
         ResultVoid modifyPermission(Session::TokenType token, User::IdType id, Permission newPermission);
 
+        // Apply several changes at once, either all of them or none.
+        ResultVoid modifyUser(Session::TokenType token, User::IdType id, const UserPatch& patch);
+        ResultVoid modifyOwnUser(Session::TokenType token, const UserPatch& patch);
+
+#ifdef AUTHENTICATION_METRICS
+        AuthenticationMetrics& getMetrics();
+#endif
+
     protected:
+        using Operation = AuthenticationMetrics::Operation;
+
         UserManager *userManager;
         SessionManager *sessionManager;
+        LoginThrottle *loginThrottle = nullptr;
+
+#ifdef AUTHENTICATION_METRICS
+        AuthenticationMetrics metrics;
+#endif
+
+        // Bodies of the entry points, which call each other without being measured twice.
+        ResultSession checkPermission(Session::TokenType token, Permission permission);
+        ResultVoid applyPatch(Session::TokenType token, User::IdType id, const UserPatch& patch);
+        ResultVoid applyOwnPatch(Session::TokenType token, const UserPatch& patch);
+
+        // Runs the function, recording its latency and error when the metrics are compiled in.
+        template <typename Function>
+        auto measure(Operation operation, Function function)
+        {
+#ifdef AUTHENTICATION_METRICS
+            MetricsTimer timer;
+            auto result = function();
+            if(result)
+                metrics.record(operation, timer.getElapsed());
+            else
+                metrics.record(operation, timer.getElapsed(), result.error());
+            return result;
+#else
+            static_cast<void>(operation);
+            return function();
+#endif
+        }
 };
\ No newline at end of file
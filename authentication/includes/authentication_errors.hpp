@@ -23,6 +23,17 @@ enum class AuthenticationError
 
     EmptyMandatoryField,
     IntegrityFailure,
+
+    IncompleteConfiguration,
+
+    // The shared storage of the user strings has no room left.
+    StringArenaFull,
+
+    // The backing file of a persistent manager couldn't be opened, mapped or synced.
+    StorageFailure,
+
+    // Too many failed logins for the username or channel, retry later.
+    Throttled,
 };
 
 template <typename T>
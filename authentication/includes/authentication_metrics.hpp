@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <stdint.h>
+
+#include "authentication_errors.hpp"
+
+// Instrumentation of the authentication libraries, compiled in only when
+// AUTHENTICATION_METRICS is defined. Recording is a few relaxed atomic
+// increments, so it's safe from any thread and never blocks. A host process
+// scrapes the values with takeSnapshot.
+
+// Latency histogram with logarithmic buckets: every power of two of nanoseconds
+// is split in SubBuckets linear buckets, so a value is off by less than 25 %.
+class LatencyHistogram
+{
+    public:
+        static constexpr size_t SubBuckets = 4;
+        static constexpr size_t BucketsAmount = SubBuckets + (32 - 2) * SubBuckets;
+
+        struct Snapshot
+        {
+            std::array<uint32_t, BucketsAmount> counts;
+            uint32_t count;
+            uint32_t max;
+
+            // Upper bound of the bucket holding the percentile, from 0 to 1.
+            uint32_t getPercentile(double percentile) const;
+        };
+
+        void record(uint32_t nanoseconds);
+        void takeSnapshot(Snapshot& snapshot) const;
+        void reset();
+
+        static size_t getBucket(uint32_t nanoseconds);
+        static uint32_t getBucketUpperBound(size_t bucket);
+
+    protected:
+        std::array<std::atomic<uint32_t>, BucketsAmount> counts{};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> max{0};
+};
+
+// Latencies and failures of each of a set of operations.
+template <size_t OperationsAmount>
+class OperationMetrics
+{
+    public:
+        struct Snapshot
+        {
+            std::array<LatencyHistogram::Snapshot, OperationsAmount> latencies;
+            std::array<uint32_t, OperationsAmount> failures;
+        };
+
+        void record(size_t operation, uint32_t nanoseconds, bool failed)
+        {
+            latencies[operation].record(nanoseconds);
+            if(failed)
+                failures[operation].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void takeSnapshot(Snapshot& snapshot) const
+        {
+            for(size_t operation = 0; operation < OperationsAmount; operation++)
+            {
+                latencies[operation].takeSnapshot(snapshot.latencies[operation]);
+                snapshot.failures[operation] = failures[operation].load(std::memory_order_relaxed);
+            }
+        }
+
+        void reset()
+        {
+            for(size_t operation = 0; operation < OperationsAmount; operation++)
+            {
+                latencies[operation].reset();
+                failures[operation].store(0, std::memory_order_relaxed);
+            }
+        }
+
+    protected:
+        std::array<LatencyHistogram, OperationsAmount> latencies;
+        std::array<std::atomic<uint32_t>, OperationsAmount> failures{};
+};
+
+// Measures the time since it was built.
+class MetricsTimer
+{
+    public:
+        MetricsTimer();
+
+        // Nanoseconds elapsed, saturated to the range of the histograms.
+        uint32_t getElapsed() const;
+
+    protected:
+        std::chrono::steady_clock::time_point start;
+};
+
+// Metrics of every Authentication entry point, and the amount of times each error was returned.
+class AuthenticationMetrics
+{
+    public:
+        enum class Operation
+        {
+            Authenticate,
+            Validate,
+            ValidateWithPermission,
+            UpdateSessions,
+            CreateUser,
+            CreateUsers,
+            DeleteUser,
+            LogOut,
+
+            ModifyOwnUsername,
+            ModifyOwnPassword,
+            ModifyOwnName,
+            ModifyOwnUser,
+
+            ModifyUsername,
+            ModifyPassword,
+            ModifyName,
+            ModifyPermission,
+            ModifyUser,
+        };
+
+        static constexpr size_t OperationsAmount = std::to_underlying(Operation::ModifyUser) + 1;
+        static constexpr size_t ErrorsAmount = std::to_underlying(AuthenticationError::Throttled) + 1;
+
+        struct Snapshot
+        {
+            OperationMetrics<OperationsAmount>::Snapshot operations;
+            std::array<uint32_t, ErrorsAmount> errors;
+        };
+
+        void record(Operation operation, uint32_t nanoseconds);
+        void record(Operation operation, uint32_t nanoseconds, AuthenticationError error);
+
+        void takeSnapshot(Snapshot& snapshot) const;
+        void reset();
+
+        static const char* getName(Operation operation);
+
+    protected:
+        OperationMetrics<OperationsAmount> operations;
+        std::array<std::atomic<uint32_t>, ErrorsAmount> errors{};
+};
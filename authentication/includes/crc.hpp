@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <stdint.h>
+
+// Lookup table of a most significant bit first CRC-16, one entry per byte value.
+constexpr std::array<uint16_t, 256> generateCrc16Table(uint16_t polynomial)
+{
+    std::array<uint16_t, 256> table{};
+    for(uint16_t i = 0; i < table.size(); i++)
+    {
+        uint16_t crc = static_cast<uint16_t>(i << 8);
+        for(int bit = 0; bit < 8; bit++)
+            crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ polynomial : crc << 1);
+        table[i] = crc;
+    }
+    return table;
+}
+
+// CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF, no reflection.
+class Crc16
+{
+    public:
+        static constexpr uint16_t Initial = 0xFFFF;
+        static constexpr uint16_t Polynomial = 0x1021;
+
+        // Pass the result of a previous call as crc to continue over split data.
+        static constexpr uint16_t compute(std::span<const uint8_t> data, uint16_t crc = Initial)
+        {
+            for(uint8_t byte : data)
+                crc = static_cast<uint16_t>(crc << 8) ^ table[(crc >> 8) ^ byte];
+
+            return crc;
+        }
+
+    protected:
+        static constexpr std::array<uint16_t, 256> table = generateCrc16Table(Polynomial);
+};
+
+// Lookup table of a least significant bit first (reflected) CRC-32, one entry per byte value.
+constexpr std::array<uint32_t, 256> generateCrc32Table(uint32_t polynomial)
+{
+    std::array<uint32_t, 256> table{};
+    for(uint32_t i = 0; i < table.size(); i++)
+    {
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}
+
+// CRC-32/ISO-HDLC, the one of zlib and Ethernet: reflected polynomial 0xEDB88320,
+// initial value and final xor 0xFFFFFFFF.
+class Crc32
+{
+    public:
+        static constexpr uint32_t Initial = 0;
+        static constexpr uint32_t Polynomial = 0xEDB88320;
+
+        // Pass the result of a previous call as crc to continue over split data.
+        static constexpr uint32_t compute(std::span<const uint8_t> data, uint32_t crc = Initial)
+        {
+            crc = ~crc;
+            for(uint8_t byte : data)
+                crc = (crc >> 8) ^ table[(crc ^ byte) & 0xFF];
+
+            return ~crc;
+        }
+
+    protected:
+        static constexpr std::array<uint32_t, 256> table = generateCrc32Table(Polynomial);
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <optional>
+#include <string_view>
+#include <stdint.h>
+
+#include "authentication_errors.hpp"
+#include "session_manager.hpp"
+
+// Counts the failed logins of every username and channel, and rejects the
+// attempts from either while it's blocked, before any password is checked.
+// After freeAttempts failures every new one doubles the block, up to
+// maxBlockSeconds, and lockoutFailures failures lock it for lockoutSeconds.
+// The count is forgotten after forgetSeconds without failures.
+//
+// The table has a fixed size. A new username or channel takes a free entry, or
+// replaces one that isn't blocked and whose failures were already forgotten.
+// While there's none, the failures of every username and channel without an
+// entry are counted together in an overflow entry, which blocks them with the
+// same backoff but is never locked out, so filling the table can't keep every
+// other account from logging in.
+class LoginThrottle
+{
+    public:
+        using ChannelId = uint32_t;
+
+        struct Policy
+        {
+            uint8_t freeAttempts = 3;
+            uint32_t baseBlockSeconds = 1;
+            uint32_t maxBlockSeconds = 300;
+            uint8_t lockoutFailures = 20;
+            uint32_t lockoutSeconds = 3600;
+            uint32_t forgetSeconds = 3600;
+        };
+
+        struct Entry
+        {
+            enum class Kind : uint8_t
+            {
+                Free,
+                Username,
+                Channel,
+            };
+
+            Kind kind = Kind::Free;
+            uint8_t failures = 0;
+            // CRC-32 of the username, or the channel id.
+            uint32_t key = 0;
+            uint32_t lastFailure = 0;
+            uint32_t blockedUntil = 0;
+        };
+
+        LoginThrottle(std::span<Entry> entriesStorage, const Clock& clock);
+
+        void setPolicy(const Policy& newPolicy);
+
+        // Throttled while the username or the channel is blocked, or the overflow entry when the table is full.
+        ResultVoid check(std::string_view username, std::optional<ChannelId> channel) const;
+
+        void recordFailure(std::string_view username, std::optional<ChannelId> channel);
+        // Only the username is cleared, one valid account must not unblock a channel.
+        void recordSuccess(std::string_view username);
+
+        // Seconds left until the username or channel can try again, zero if it isn't blocked.
+        uint32_t getBlockedSeconds(std::string_view username, std::optional<ChannelId> channel) const;
+
+    protected:
+        std::span<Entry> entries;
+        Entry overflow;
+        const Clock* clock;
+        Policy policy;
+
+        static uint32_t getKey(std::string_view username);
+
+        Entry* find(Entry::Kind kind, uint32_t key);
+        const Entry* find(Entry::Kind kind, uint32_t key) const;
+        uint32_t getBlockedSeconds(const Entry* entry, uint32_t currentTime) const;
+
+        // Free entry, or the one forgotten the longest ago. Null when every entry still counts failures.
+        Entry* findReplaceable(uint32_t currentTime);
+        const Entry* findReplaceable(uint32_t currentTime) const;
+        // Entry whose block applies to the key: its own, the overflow one when the table is full, or null.
+        const Entry* findBlocking(Entry::Kind kind, uint32_t key, uint32_t currentTime) const;
+
+        // Entry to count a failure in, taking a replaceable one if there's none yet, or the overflow one.
+        Entry& acquire(Entry::Kind kind, uint32_t key, uint32_t currentTime);
+        void addFailure(Entry& entry, uint32_t currentTime);
+};
+
+template <size_t EntriesAmount>
+class StaticLoginThrottle : public LoginThrottle
+{
+    protected:
+        std::array<Entry, EntriesAmount> entriesStorage;
+
+    public:
+        StaticLoginThrottle(const Clock& clock)
+            : LoginThrottle(entriesStorage, clock)
+        {}
+};
@@ -8,15 +8,21 @@ class Session
         using TokenType = uint64_t;
 
         Session() = default;
-        Session(const User& user, uint32_t validitySeconds, uint32_t currentTime);
+        Session(const User& user, TokenType token, uint32_t validitySeconds, uint32_t currentTime);
 
-        void start(const User& user, uint32_t validitySeconds, uint32_t currentTime);
+        // The token is generated by the SessionManager, so starting a session never allocates.
+        void start(const User& user, TokenType token, uint32_t validitySeconds, uint32_t currentTime);
+        // Resumes a session saved before a restart, keeping its token.
+        void restore(const User& user, TokenType token, uint32_t expireTime);
 
         const User* getUser() const;
         TokenType getToken() const;
+        uint32_t getExpireTime() const;
         bool isExpired() const;
         void update(uint32_t currentTime);
         void expire();
+        // Moves the expiration, keeping the user and token.
+        void extend(uint32_t newExpireTime);
 
         bool operator==(const Session& other) const;
 
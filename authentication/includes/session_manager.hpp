@@ -1,13 +1,19 @@
 #pragma once
 
+#include <random>
+
 #include "session.hpp"
 
 #include "authentication_errors.hpp"
 
+// Source of the current time in seconds. Derived clocks can read a real time
+// source, or be moved by hand in simulations.
 class Clock
 {
     public:
-        uint32_t getTime() const
+        virtual ~Clock() = default;
+
+        virtual uint32_t getTime() const
         {
             return 1;
         }
@@ -19,29 +25,66 @@ class SessionManager
 {
     public:
         SessionManager(std::span<Session*> sessionsStorage, const Clock& clock);
+        virtual ~SessionManager() = default;
 
+        // Fails for expired sessions, even before updateSessions frees them. With a
+        // renewal interval, a valid session is extended to the full validity again.
         ResultSession validate(Session::TokenType token);
 
         const Session* getSession(const User& user) const;
 
         ResultSession createSession(const User& user);
 
+        // Recreates a session saved before a restart. Fails if it already expired.
+        ResultSession restoreSession(const User& user, Session::TokenType token, uint32_t expireTime);
+
         void expireSession(const Session& user);
 
         void updateSessions();
 
+        // Applies to the sessions created or renewed from now on.
+        // A shorter validity also clamps the renewal interval.
+        void setSessionValiditySeconds(uint32_t seconds);
+
+        // Sliding expiration: a session is renewed when validated at least this long
+        // after its last renewal, so it's written once per interval instead of on
+        // every call. Zero, the default, never renews. Clamped below the session
+        // validity, as a session would expire before a longer interval elapsed.
+        void setRenewalIntervalSeconds(uint32_t seconds);
+
         bool hasSession(const User& user) const;
 
+        // Every session slot, expired ones included.
+        std::span<const Session* const> getSessions() const;
+
     protected:
         std::span<Session*> sessions;
 
         const Clock* clock;
 
         uint32_t sessionValiditySeconds = 3600;
+        uint32_t renewalIntervalSeconds = 0;
+
+        // Seeded once at construction: std::random_device may allocate and open files.
+        std::mt19937_64 tokenGenerator;
+
+        // Never zero, which marks a free session.
+        Session::TokenType generateToken();
 
         Session* getFreeSession();
 
+        void renewSession(Session& session, uint32_t currentTime);
+
+        // Longest renewal interval that still renews a session before it expires.
+        uint32_t getMaxRenewalIntervalSeconds() const;
+
         Session* getSessionByUser(const User& user) const;
+
+        // Calls sessionChanged with the index of the session.
+        void refreshSession(const Session* session);
+
+        // Called after a session started, was restored or expired. Does nothing by default.
+        virtual void sessionChanged(size_t index);
 };
 
 template <size_t SessionAmount>
@@ -15,12 +15,15 @@ enum class Permission
     None,
 };
 
+struct UserPatch;
+
 class User
 {
     public:
         using IdType = uint16_t;
 
         User(std::span<char> usernameStorage, std::span<char> passwordStorage, std::span<char> nameStorage);
+        virtual ~User() = default;
 
         bool authenticate(std::string_view password) const;
 
@@ -31,6 +34,7 @@ class User
         Permission getPermission() const;
         bool hasPermission(Permission permission) const;
         bool isValid() const;
+        bool isReserved() const;
 
         ResultVoid setUsername(std::string_view newUsername);
         ResultVoid setPassword(std::string_view newPassword);
@@ -38,25 +42,64 @@ class User
         void setId(User::IdType newId);
         void setPermission(Permission newPermission);
         void makeValid();
+        // Keeps an invalid slot from being handed out while its fields are filled in place.
+        virtual ResultVoid reserve();
 
         // Method used to receive a single error code for all fields set.
         ResultVoid setBufferedFields(std::string_view username, std::string_view password, std::string_view name);
 
+        // Storage of each field, for callers that write the strings in place.
+        // The lengths written must be set afterwards with setStoredFields.
+        std::span<char> getUsernameStorage();
+        std::span<char> getPasswordStorage();
+        std::span<char> getNameStorage();
+        ResultVoid setStoredFields(size_t usernameLength, size_t passwordLength, size_t nameLength);
+
+        // Checks every field of the patch against the storage, so applying it can't fail.
+        ResultVoid checkPatch(const UserPatch& patch) const;
+        virtual void applyPatch(const UserPatch& patch);
+
         void reset();
 
         bool operator==(const User& other) const;
 
     protected:
+        enum class StringField
+        {
+            Username,
+            Password,
+            Name,
+        };
+
         std::span<char> username;
         std::span<char> password;
         std::span<char> name;
 
+        // Lengths of the strings, which are also null terminated in their storage.
+        size_t usernameLength = 0;
+        size_t passwordLength = 0;
+        size_t nameLength = 0;
+
         IdType id;
         Permission permission;
         bool valid;
-
-        static ResultVoid setString(std::string_view stringValue, std::span<char> storage);
-        static std::string_view getString(std::span<char> storage);
+        bool reserved = false;
+
+        std::span<char>& getStorage(StringField field);
+        size_t& getLength(StringField field);
+        static AuthenticationError getOverflowError(StringField field);
+
+        ResultVoid setStoredString(StringField field, size_t newLength);
+        static std::string_view getString(std::span<char> storage, size_t length);
+
+        // Storage hooks, the default storage is fixed. Derived users may move the
+        // storage of a field when it's prepared, keeping its content only if it doesn't grow.
+        // Users whose storage can move the strings of other users override setString
+        // and applyPatch, as the values may be those strings.
+        virtual ResultVoid setString(StringField field, std::string_view stringValue);
+        virtual ResultVoid prepareString(StringField field, size_t length);
+        virtual ResultVoid checkStrings(const UserPatch& patch) const;
+        virtual void releaseStrings();
 };
 
 template <size_t UsernameMaxLength, size_t PasswordMaxLength, size_t NameMaxLength>
@@ -2,8 +2,11 @@
 
 #include <span>
 #include <array>
+#include <stdint.h>
 
 #include "user.hpp"
+#include "user_patch.hpp"
+#include "user_spec.hpp"
 #include "session.hpp"
 
 #include "authentication_errors.hpp"
@@ -14,27 +17,99 @@ class UserManager
 {
     public:
         ResultUser createUser(Permission newPermission, std::string_view newUsername, std::string_view newPassword, std::string_view newName = "");
+        // Creates every user of specs, writing the result of each one at the same index of results.
+        // The table is scanned once for the whole batch instead of once per user. Returns the amount created.
+        size_t createUsers(std::span<const UserSpec> specs, std::span<ResultUser> results);
+
+        // Creating a user in place: reserve a free slot, write the strings in its
+        // storage and commit it with their lengths. A slot not committed must be released.
+        Result<User*> reserveUser();
+        ResultUser commitUser(User& reservedUser, Permission newPermission, size_t usernameLength, size_t passwordLength, size_t nameLength = 0);
+        void releaseUser(User& reservedUser);
+
+        // Creates or overwrites the user with that id, used to load users saved elsewhere.
+        ResultUser restoreUser(User::IdType id, Permission permission, std::string_view username, std::string_view password, std::string_view name);
+
         ResultUser getUser(std::string_view username) const;
         ResultUser getUser(User::IdType id) const;
+        // Index of the slot holding the user, it doesn't change while the user exists.
+        Result<size_t> getSlot(const User& user) const;
+        // Valid user in the slot, used to go over every user in slot order.
+        ResultUser getUserInSlot(size_t slot) const;
         ResultVoid updateUser(User& updatedUser);
+        // Validates the whole patch, including username uniqueness, before writing the stored user.
+        ResultVoid patchUser(User::IdType id, const UserPatch& patch);
         ResultVoid deleteUser(std::string_view username);
         ResultVoid deleteUser(User::IdType id);
         ResultVoid deleteUser(const User& user);
 
-        User::IdType getMaxUsers();
+        // Writes the ids of the users with exactly that permission, returns how many were found.
+        size_t findUsers(Permission permission, std::span<User::IdType> foundIds) const;
+
+        size_t getMaxUsers() const;
+
+        enum class SlotState : uint8_t
+        {
+            Free,
+            Reserved,
+            Valid,
+        };
 
         UserManager(std::span<User*> usersStorage);
+        virtual ~UserManager() = default;
+        // The hot metadata of every slot is mirrored in parallel arrays, the size of usersStorage,
+        // so scans and username probes don't dereference the users. Users must only be modified
+        // through the manager to keep them in sync.
+        UserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                    std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage);
 
     protected:
+        static constexpr size_t NoSlot = SIZE_MAX;
+
         std::span<User*> users;
 
+        // Empty when the manager was built without metadata arrays.
+        std::span<User::IdType> ids;
+        std::span<Permission> permissions;
+        std::span<SlotState> states;
+        std::span<uint32_t> usernameHashes;
+
         User::IdType loadedUsers = 0;
         User::IdType idCounter = 0;
 
         Result<User*> getUserByUsername(std::string_view username) const;
         Result<User*> getUserById(User::IdType id) const;
-        User* getFreeUser() const;
         bool usernameExists(std::string_view username) const;
+
+        // Slot indexes, NoSlot if there's none.
+        size_t findUsername(std::string_view username) const;
+        size_t findId(User::IdType id) const;
+        size_t findFree() const;
+        size_t findSlot(const User& user) const;
+
+        // Next id not used by any user, the counter wraps around after the largest id.
+        // Fails only when the table has more slots than there are ids and every id is taken.
+        Result<User::IdType> getNextId();
+
+        // Fills the free slot with a new user, the strings are validated first.
+        ResultUser createUserInSlot(size_t slot, User::IdType id, const UserSpec& spec);
+
+        enum class Mutation : uint8_t
+        {
+            Reserved,
+            Released,
+            Created,
+            Updated,
+            Deleted,
+        };
+
+        // Called after every change to the user in a slot, with the id the user has or had.
+        void refreshSlot(size_t slot, Mutation mutation, User::IdType id);
+        // Copies the metadata of the user in the slot to the arrays.
+        void mirrorSlot(size_t slot);
+        // Hook for managers that keep the users somewhere else too.
+        virtual void userChanged(size_t slot, Mutation mutation, User::IdType id);
+        static uint32_t hashUsername(std::string_view username);
 };
 
 template <size_t UsersAmount, size_t UsernameLength, size_t PasswordLength, size_t NameLength>
@@ -44,10 +119,14 @@ class StaticUserManager : public UserManager
         typedef StaticUser<UsernameLength, PasswordLength, NameLength> UserType;
         std::array<UserType, UsersAmount> usersStorage;
         std::array<User*, UsersAmount> usersPointers;
+        std::array<User::IdType, UsersAmount> idsStorage;
+        std::array<Permission, UsersAmount> permissionsStorage;
+        std::array<SlotState, UsersAmount> statesStorage;
+        std::array<uint32_t, UsersAmount> usernameHashesStorage;
 
     public:
         StaticUserManager()
-            : UserManager(usersPointers)
+            : UserManager(usersPointers, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage)
         {
             for (size_t i = 0; i < UsersAmount; i++)
                 usersPointers[i] = &usersStorage[i];
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "user.hpp"
+
+// Set of changes to a stored user. Fields left empty keep their value.
+// The whole patch is validated before any field is written.
+struct UserPatch
+{
+    std::optional<std::string_view> username{};
+    std::optional<std::string_view> password{};
+    std::optional<std::string_view> name{};
+    std::optional<Permission> permission{};
+};
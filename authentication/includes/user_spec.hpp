@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string_view>
+
+#include "user.hpp"
+
+// Fields of a user to create, used to create several users at once.
+struct UserSpec
+{
+    Permission permission = Permission::None;
+    std::string_view username;
+    std::string_view password;
+    std::string_view name;
+};
@@ -0,0 +1,388 @@
+#include "arena_user_manager.hpp"
+#include "user_patch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+static constexpr size_t FieldsPerUser = 3;
+
+ArenaUser::ArenaUser()
+    : User({}, {}, {})
+{}
+
+void ArenaUser::attach(ArenaUserManager& newManager, uint32_t newSlot)
+{
+    manager = &newManager;
+    slot = newSlot;
+}
+
+ResultVoid ArenaUser::reserve()
+{
+    for(StringField field : {StringField::Username, StringField::Password, StringField::Name})
+    {
+        auto prepared = prepareString(field, manager->getMaxLength(field) - 1);
+        if(!prepared)
+        {
+            reset();
+            return Error(prepared.error());
+        }
+
+        getStorage(field)[0] = '\0';
+        getLength(field) = 0;
+    }
+
+    return User::reserve();
+}
+
+uint32_t ArenaUser::getOwner(StringField field) const
+{
+    return slot * FieldsPerUser + std::to_underlying(field);
+}
+
+void ArenaUser::relocate(StringField field, char* data)
+{
+    std::span<char>& storage = getStorage(field);
+    storage = std::span(data, storage.size());
+}
+
+void ArenaUser::applyPatch(const UserPatch& patch)
+{
+    // The patch was checked, like in User::applyPatch the strings can't fail.
+    (void)setStrings({patch.username, patch.password, patch.name});
+
+    if(patch.permission)
+        permission = *patch.permission;
+}
+
+ResultVoid ArenaUser::setString(StringField field, std::string_view stringValue)
+{
+    StringValues values;
+    values[std::to_underlying(field)] = stringValue;
+    return setStrings(values);
+}
+
+std::array<const char*, 3> ArenaUser::getSources(const StringValues& values)
+{
+    std::array<const char*, FieldsPerUser> sources{};
+    for(size_t index = 0; index < values.size(); index++)
+        if(values[index])
+            sources[index] = values[index]->data();
+
+    return sources;
+}
+
+bool ArenaUser::isReferenced(StringField field, std::span<const char> storage, std::span<const char* const> sources)
+{
+    // Only the values set after the field still need their source.
+    uintptr_t start = reinterpret_cast<uintptr_t>(storage.data());
+    for(size_t index = std::to_underlying(field) + 1; index < sources.size(); index++)
+    {
+        uintptr_t source = reinterpret_cast<uintptr_t>(sources[index]);
+        if(source && source >= start && source < start + storage.size())
+            return true;
+    }
+
+    return false;
+}
+
+ResultVoid ArenaUser::setStrings(const StringValues& values)
+{
+    // The sources of the values, then the blocks kept until every value is copied.
+    std::array<const char*, FieldsPerUser * 2> tracked{};
+    std::span<const char*> sources = std::span(tracked).first(FieldsPerUser);
+    std::span<const char*> retained = std::span(tracked).last(FieldsPerUser);
+    std::ranges::copy(getSources(values), sources.begin());
+
+    if(manager)
+        manager->trackedSources = tracked;
+
+    ResultVoid result;
+    for(StringField field : {StringField::Username, StringField::Password, StringField::Name})
+    {
+        size_t index = std::to_underlying(field);
+        if(!values[index])
+            continue;
+
+        size_t length = values[index]->length();
+        std::span<char>& storage = getStorage(field);
+
+        uintptr_t source = reinterpret_cast<uintptr_t>(sources[index]);
+        uintptr_t start = reinterpret_cast<uintptr_t>(storage.data());
+
+        // A value set later is part of this string, like a name set to the current
+        // username, so the block is kept as it is and the field gets a new one.
+        if(manager && isReferenced(field, storage, sources))
+        {
+            retained[index] = storage.data();
+            manager->retain(storage);
+            storage = {};
+            getLength(field) = 0;
+        }
+        // A shrunk block may get a header after the new string, which would overwrite
+        // a value taken from the end of the current string, so the value is moved first.
+        else if(length && length + 1 < storage.size() && source > start && source < start + storage.size())
+        {
+            std::memmove(storage.data(), sources[index], length);
+            sources[index] = storage.data();
+        }
+
+        result = prepareString(field, length);
+        if(!result)
+            break;
+
+        // The value may overlap the storage when it's a part of the current string.
+        if(length)
+            std::memmove(storage.data(), sources[index], length);
+        storage[length] = '\0';
+        getLength(field) = length;
+    }
+
+    for(const char* block : retained)
+        if(block)
+            manager->release(block);
+
+    if(manager)
+        manager->trackedSources = {};
+    return result;
+}
+
+ResultVoid ArenaUser::prepareString(StringField field, size_t length)
+{
+    if(!manager || length >= manager->getMaxLength(field))
+        return Error(getOverflowError(field));
+
+    std::span<char>& storage = getStorage(field);
+    size_t size = length + 1;
+    if(size == storage.size())
+        return {};
+
+    if(size < storage.size())
+    {
+        manager->shrink(storage, size);
+        return {};
+    }
+
+    if(!storage.empty())
+        manager->release(storage.data());
+    storage = {};
+    getLength(field) = 0;
+
+    auto block = manager->allocate(getOwner(field), size);
+    if(!block)
+        return Error(block.error());
+
+    storage = *block;
+    return {};
+}
+
+ResultVoid ArenaUser::checkStrings(const UserPatch& patch) const
+{
+    // The fields are prepared in this order, each one freeing its block before allocating the new one.
+    // A block holding a value set later is only freed once every field is set, like in setStrings.
+    std::array<const char*, FieldsPerUser> sources = getSources({patch.username, patch.password, patch.name});
+
+    size_t available = manager ? manager->getFreeBytes() : 0;
+    auto check = [&](StringField field, const std::optional<std::string_view>& value, std::span<const char> storage) -> ResultVoid
+    {
+        if(!value)
+            return {};
+
+        if(!manager || value->length() >= manager->getMaxLength(field))
+            return Error(getOverflowError(field));
+
+        size_t size = value->length() + 1;
+        bool referenced = isReferenced(field, storage, sources);
+        if(size <= storage.size() && !referenced)
+            return {};
+
+        if(!storage.empty() && !referenced)
+            available += ArenaUserManager::HeaderSize + storage.size();
+
+        if(available < ArenaUserManager::HeaderSize + size)
+            return Error(AuthenticationError::StringArenaFull);
+
+        available -= ArenaUserManager::HeaderSize + size;
+        return {};
+    };
+
+    auto checked = check(StringField::Username, patch.username, username);
+    if(!checked)
+        return checked;
+
+    checked = check(StringField::Password, patch.password, password);
+    if(!checked)
+        return checked;
+
+    return check(StringField::Name, patch.name, name);
+}
+
+void ArenaUser::releaseStrings()
+{
+    for(StringField field : {StringField::Username, StringField::Password, StringField::Name})
+    {
+        std::span<char>& storage = getStorage(field);
+        if(!storage.empty())
+            manager->release(storage.data());
+        storage = {};
+    }
+}
+
+ArenaUserManager::ArenaUserManager(std::span<User*> usersStorage, std::span<char> arenaStorage,
+                                   size_t usernameMaxLength, size_t passwordMaxLength, size_t nameMaxLength)
+    : UserManager(usersStorage), arena(arenaStorage),
+      usernameMaxLength(usernameMaxLength), passwordMaxLength(passwordMaxLength), nameMaxLength(nameMaxLength)
+{}
+
+ArenaUserManager::ArenaUserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                                   std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage, std::span<char> arenaStorage,
+                                   size_t usernameMaxLength, size_t passwordMaxLength, size_t nameMaxLength)
+    : UserManager(usersStorage, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage), arena(arenaStorage),
+      usernameMaxLength(usernameMaxLength), passwordMaxLength(passwordMaxLength), nameMaxLength(nameMaxLength)
+{}
+
+size_t ArenaUserManager::getFreeBytes() const
+{
+    return arena.size() - used + released;
+}
+
+size_t ArenaUserManager::getMaxLength(ArenaUser::StringField field) const
+{
+    switch(field)
+    {
+        case ArenaUser::StringField::Username:
+            return usernameMaxLength;
+        case ArenaUser::StringField::Password:
+            return passwordMaxLength;
+        default:
+            return nameMaxLength;
+    }
+}
+
+Result<std::span<char>> ArenaUserManager::allocate(uint32_t owner, size_t size)
+{
+    size_t blockSize = HeaderSize + size;
+    if(size > UINT16_MAX || getFreeBytes() < blockSize)
+        return Error(AuthenticationError::StringArenaFull);
+
+    if(arena.size() - used < blockSize)
+        compact();
+
+    size_t offset = used;
+    writeHeader(offset, {owner, static_cast<uint16_t>(size)});
+    used += blockSize;
+
+    return arena.subspan(offset + HeaderSize, size);
+}
+
+void ArenaUserManager::shrink(std::span<char>& block, size_t size)
+{
+    size_t offset = block.data() - arena.data() - HeaderSize;
+    BlockHeader header = readHeader(offset);
+    size_t end = offset + HeaderSize + header.size;
+    size_t remainder = header.size - size;
+
+    if(end == used)
+    {
+        header.size = size;
+        writeHeader(offset, header);
+        used -= remainder;
+    }
+    else if(remainder >= HeaderSize)
+    {
+        header.size = size;
+        writeHeader(offset, header);
+        writeHeader(offset + HeaderSize + size, {FreeOwner, static_cast<uint16_t>(remainder - HeaderSize)});
+        released += remainder;
+    }
+
+    // Otherwise the remainder stays in the block until the string is freed.
+    block = block.first(size);
+}
+
+void ArenaUserManager::retain(std::span<char> block)
+{
+    size_t offset = block.data() - arena.data() - HeaderSize;
+    BlockHeader header = readHeader(offset);
+    header.owner = RetainedOwner;
+    writeHeader(offset, header);
+}
+
+void ArenaUserManager::release(const char* block)
+{
+    size_t offset = block - arena.data() - HeaderSize;
+    BlockHeader header = readHeader(offset);
+    size_t blockSize = HeaderSize + header.size;
+
+    if(offset + blockSize == used)
+    {
+        used = offset;
+        return;
+    }
+
+    header.owner = FreeOwner;
+    writeHeader(offset, header);
+    released += blockSize;
+}
+
+void ArenaUserManager::compact()
+{
+    // Tracked pointers may point anywhere, so they're compared as integers.
+    uintptr_t arenaAddress = reinterpret_cast<uintptr_t>(arena.data());
+
+    size_t read = 0;
+    size_t write = 0;
+    while(read < used)
+    {
+        BlockHeader header = readHeader(read);
+        size_t blockSize = HeaderSize + header.size;
+
+        if(header.owner != FreeOwner)
+        {
+            if(write != read)
+            {
+                std::memmove(arena.data() + write, arena.data() + read, blockSize);
+
+                for(const char*& source : trackedSources)
+                {
+                    uintptr_t address = reinterpret_cast<uintptr_t>(source);
+                    if(address >= arenaAddress + read && address < arenaAddress + read + blockSize)
+                        source -= read - write;
+                }
+
+                // A retained block isn't the storage of any field anymore, it's followed through the tracked pointers.
+                if(header.owner == RetainedOwner)
+                {
+                    write += blockSize;
+                    read += blockSize;
+                    continue;
+                }
+
+                auto user = static_cast<ArenaUser*>(users[header.owner / FieldsPerUser]);
+                auto field = static_cast<ArenaUser::StringField>(header.owner % FieldsPerUser);
+                user->relocate(field, arena.data() + write + HeaderSize);
+            }
+            write += blockSize;
+        }
+
+        read += blockSize;
+    }
+
+    used = write;
+    released = 0;
+}
+
+ArenaUserManager::BlockHeader ArenaUserManager::readHeader(size_t offset) const
+{
+    BlockHeader header;
+    std::memcpy(&header.owner, arena.data() + offset, sizeof(header.owner));
+    std::memcpy(&header.size, arena.data() + offset + sizeof(header.owner), sizeof(header.size));
+    return header;
+}
+
+void ArenaUserManager::writeHeader(size_t offset, BlockHeader header)
+{
+    std::memcpy(arena.data() + offset, &header.owner, sizeof(header.owner));
+    std::memcpy(arena.data() + offset + sizeof(header.owner), &header.size, sizeof(header.size));
+}
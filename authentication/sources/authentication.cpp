@@ -9,30 +9,53 @@ Authentication::Authentication(UserManager& userManager, SessionManager& session
 
 }
 
-ResultSession Authentication::authenticate(std::string_view username, std::string_view password)
+ResultSession Authentication::authenticate(std::string_view username, std::string_view password, std::optional<LoginThrottle::ChannelId> channel)
 {
-    auto user = userManager->getUser(username);
-    if(!user)
-        return Error(AuthenticationError::UsernameNotFound);
-
-    if(!(*user)->authenticate(password))
-        return Error(AuthenticationError::IncorrectPassword);
-
-    auto session = sessionManager->createSession(**user);
-    if(!session)
-        return Error(AuthenticationError::SessionBufferFull);
-
-    return session;
+    return measure(Operation::Authenticate, [&]() -> ResultSession {
+        if(loginThrottle)
+        {
+            auto allowed = loginThrottle->check(username, channel);
+            if(!allowed)
+                return Error(allowed.error());
+        }
+
+        // Unknown usernames count as failures too, so guessing usernames is throttled like guessing passwords.
+        auto user = userManager->getUser(username);
+        if(!user || !(*user)->authenticate(password))
+        {
+            if(loginThrottle)
+                loginThrottle->recordFailure(username, channel);
+
+            return Error(user ? AuthenticationError::IncorrectPassword : AuthenticationError::UsernameNotFound);
+        }
+
+        if(loginThrottle)
+            loginThrottle->recordSuccess(username);
+
+        auto session = sessionManager->createSession(**user);
+        if(!session)
+            return Error(AuthenticationError::SessionBufferFull);
+
+        return session;
+    });
 }
 
 ResultSession Authentication::validate(Session::TokenType token)
 {
-    return sessionManager->validate(token);
+    return measure(Operation::Validate, [&]() {
+        return sessionManager->validate(token);
+    });
 }
 
 void Authentication::updateSessions()
 {
-    return sessionManager->updateSessions();
+#ifdef AUTHENTICATION_METRICS
+    MetricsTimer timer;
+    sessionManager->updateSessions();
+    metrics.record(Operation::UpdateSessions, timer.getElapsed());
+#else
+    sessionManager->updateSessions();
+#endif
 }
 
 UserManager* Authentication::getUserManager()
@@ -45,182 +68,208 @@ SessionManager* Authentication::getSessionManager()
     return sessionManager;
 }
 
-ResultSession Authentication::validateWithPermission(Session::TokenType token, Permission permission)
+void Authentication::setLoginThrottle(LoginThrottle& throttle)
 {
-    auto session = sessionManager->validate(token);
-    if(!session)
-        return Error(session.error());
+    loginThrottle = &throttle;
+}
 
-    if(!(*session)->getUser()->hasPermission(permission))
-        return Error(AuthenticationError::InsufficientPermissions);
+#ifdef AUTHENTICATION_METRICS
+AuthenticationMetrics& Authentication::getMetrics()
+{
+    return metrics;
+}
+#endif
 
-    return session;
+ResultSession Authentication::validateWithPermission(Session::TokenType token, Permission permission)
+{
+    return measure(Operation::ValidateWithPermission, [&]() {
+        return checkPermission(token, permission);
+    });
 }
 
 Result<User::IdType> Authentication::createUser(Session::TokenType token, Permission newPermission, std::string_view newUsername, std::string_view newPassword, std::string_view newName)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
-    if(!session)
-        return Error(session.error());
+    return measure(Operation::CreateUser, [&]() -> Result<User::IdType> {
+        auto session = checkPermission(token, Permission::Superuser);
+        if(!session)
+            return Error(session.error());
 
-    auto newUser = userManager->createUser(newPermission, newUsername, newPassword, newName);
-    if(!newUser)
-        return Error(newUser.error());
+        auto newUser = userManager->createUser(newPermission, newUsername, newPassword, newName);
+        if(!newUser)
+            return Error(newUser.error());
 
-    return (*newUser)->getId();
+        return (*newUser)->getId();
+    });
 }
 
-ResultVoid Authentication::deleteUser(Session::TokenType token, const User& user)
+Result<User::IdType> Authentication::createUser(Session::TokenType token, Permission newPermission, User& reservedUser, size_t usernameLength, size_t passwordLength, size_t nameLength)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
-    if(!session)
-        return Error(session.error());
+    return measure(Operation::CreateUser, [&]() -> Result<User::IdType> {
+        auto session = checkPermission(token, Permission::Superuser);
+        if(!session)
+            return Error(session.error());
+
+        auto newUser = userManager->commitUser(reservedUser, newPermission, usernameLength, passwordLength, nameLength);
+        if(!newUser)
+            return Error(newUser.error());
 
-    return userManager->deleteUser(user);
+        return (*newUser)->getId();
+    });
 }
 
-ResultVoid Authentication::deleteUser(Session::TokenType token, User::IdType userId)
+Result<size_t> Authentication::createUsers(Session::TokenType token, std::span<const UserSpec> specs, std::span<ResultUser> results)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
-    if(!session)
-        return Error(session.error());
+    return measure(Operation::CreateUsers, [&]() -> Result<size_t> {
+        auto session = checkPermission(token, Permission::Superuser);
+        if(!session)
+            return Error(session.error());
 
-    return userManager->deleteUser(userId);
+        return userManager->createUsers(specs, results);
+    });
 }
 
-ResultVoid Authentication::logOut(Session::TokenType token)
+ResultVoid Authentication::deleteUser(Session::TokenType token, const User& user)
 {
-    auto session = sessionManager->validate(token);
-    if(!session)
-        return Error(session.error());
+    return measure(Operation::DeleteUser, [&]() -> ResultVoid {
+        auto session = checkPermission(token, Permission::Superuser);
+        if(!session)
+            return Error(session.error());
 
-    sessionManager->expireSession(**session);
-    return {};
+        return userManager->deleteUser(user);
+    });
 }
 
-ResultVoid Authentication::modifyOwnUsername(Session::TokenType token, std::string_view newUsername)
+ResultVoid Authentication::deleteUser(Session::TokenType token, User::IdType userId)
 {
-    auto session = sessionManager->validate(token);
-    if(!session)
-        return Error(session.error());
+    return measure(Operation::DeleteUser, [&]() -> ResultVoid {
+        auto session = checkPermission(token, Permission::Superuser);
+        if(!session)
+            return Error(session.error());
 
-    User updatedUser = *(*session)->getUser();
+        return userManager->deleteUser(userId);
+    });
+}
 
-    auto updated = updatedUser.setUsername(newUsername);
-    if(!updated)
-        return Error(updated.error());
+ResultVoid Authentication::logOut(Session::TokenType token)
+{
+    return measure(Operation::LogOut, [&]() -> ResultVoid {
+        auto session = sessionManager->validate(token);
+        if(!session)
+            return Error(session.error());
+
+        sessionManager->expireSession(**session);
+        return {};
+    });
+}
 
-    return userManager->updateUser(updatedUser);
+ResultVoid Authentication::modifyOwnUsername(Session::TokenType token, std::string_view newUsername)
+{
+    return measure(Operation::ModifyOwnUsername, [&]() {
+        return applyOwnPatch(token, UserPatch{.username = newUsername});
+    });
 }
 
 ResultVoid Authentication::modifyOwnPassword(Session::TokenType token, std::string_view oldPassword, std::string_view newPassword)
 {
-    auto session = sessionManager->validate(token);
-    if(!session)
-        return Error(session.error());
-
-    User updatedUser = *(*session)->getUser();
+    return measure(Operation::ModifyOwnPassword, [&]() -> ResultVoid {
+        auto session = sessionManager->validate(token);
+        if(!session)
+            return Error(session.error());
 
-    if(!updatedUser.authenticate(oldPassword))
-        return Error(AuthenticationError::IncorrectPassword);
+        const User* user = (*session)->getUser();
+        if(!user)
+            return Error(AuthenticationError::IntegrityFailure);
 
-    auto updated = updatedUser.setPassword(newPassword);
-    if(!updated)
-        return Error(updated.error());
+        if(!user->authenticate(oldPassword))
+            return Error(AuthenticationError::IncorrectPassword);
 
-    return userManager->updateUser(updatedUser);
+        return userManager->patchUser(user->getId(), UserPatch{.password = newPassword});
+    });
 }
 
 ResultVoid Authentication::modifyOwnName(Session::TokenType token, std::string_view newName)
 {
-    auto session = sessionManager->validate(token);
-    if(!session)
-        return Error(session.error());
-
-    const User* user = (*session)->getUser();
-    if(!user)
-        return Error(AuthenticationError::IntegrityFailure);
-
-    User updatedUser = *user;
-
-    auto updated = updatedUser.setName(newName);
-    if(!updated)
-        return Error(updated.error());
-
-    return userManager->updateUser(updatedUser);
+    return measure(Operation::ModifyOwnName, [&]() {
+        return applyOwnPatch(token, UserPatch{.name = newName});
+    });
 }
 
-
 ResultVoid Authentication::modifyUsername(Session::TokenType token, User::IdType id, std::string_view newUsername)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
-    if(!session)
-        return Error(session.error());
-
-    auto user = userManager->getUser(id);
-    if(!user)
-        return Error(AuthenticationError::IntegrityFailure);
-
-    User updatedUser = **user;
-
-    auto updated = updatedUser.setUsername(newUsername);
-    if(!updated)
-        return Error(updated.error());
-
-    return userManager->updateUser(updatedUser);
+    return measure(Operation::ModifyUsername, [&]() {
+        return applyPatch(token, id, UserPatch{.username = newUsername});
+    });
 }
 
 ResultVoid Authentication::modifyPassword(Session::TokenType token, User::IdType id, std::string_view newPassword)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
-    if(!session)
-        return Error(session.error());
+    return measure(Operation::ModifyPassword, [&]() {
+        return applyPatch(token, id, UserPatch{.password = newPassword});
+    });
+}
 
-    auto user = userManager->getUser(id);
-    if(!user)
-        return Error(AuthenticationError::IntegrityFailure);
+ResultVoid Authentication::modifyName(Session::TokenType token, User::IdType id, std::string_view newName)
+{
+    return measure(Operation::ModifyName, [&]() {
+        return applyPatch(token, id, UserPatch{.name = newName});
+    });
+}
 
-    User updatedUser = **user;
+ResultVoid Authentication::modifyPermission(Session::TokenType token, User::IdType id, Permission newPermission)
+{
+    return measure(Operation::ModifyPermission, [&]() {
+        return applyPatch(token, id, UserPatch{.permission = newPermission});
+    });
+}
 
-    auto updated = updatedUser.setPassword(newPassword);
-    if(!updated)
-        return Error(updated.error());
+ResultVoid Authentication::modifyUser(Session::TokenType token, User::IdType id, const UserPatch& patch)
+{
+    return measure(Operation::ModifyUser, [&]() {
+        return applyPatch(token, id, patch);
+    });
+}
 
-    return userManager->updateUser(updatedUser);
+ResultVoid Authentication::modifyOwnUser(Session::TokenType token, const UserPatch& patch)
+{
+    return measure(Operation::ModifyOwnUser, [&]() {
+        return applyOwnPatch(token, patch);
+    });
 }
 
-ResultVoid Authentication::modifyName(Session::TokenType token, User::IdType id, std::string_view newName)
+ResultSession Authentication::checkPermission(Session::TokenType token, Permission permission)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
+    auto session = sessionManager->validate(token);
     if(!session)
         return Error(session.error());
 
-    auto user = userManager->getUser(id);
-    if(!user)
-        return Error(AuthenticationError::IntegrityFailure);
+    if(!(*session)->getUser()->hasPermission(permission))
+        return Error(AuthenticationError::InsufficientPermissions);
 
-    User updatedUser = **user;
+    return session;
+}
 
-    auto updated = updatedUser.setName(newName);
-    if(!updated)
-        return Error(updated.error());
+ResultVoid Authentication::applyPatch(Session::TokenType token, User::IdType id, const UserPatch& patch)
+{
+    auto session = checkPermission(token, Permission::Superuser);
+    if(!session)
+        return Error(session.error());
 
-    return userManager->updateUser(updatedUser);
+    return userManager->patchUser(id, patch);
 }
 
-ResultVoid Authentication::modifyPermission(Session::TokenType token, User::IdType id, Permission newPermission)
+ResultVoid Authentication::applyOwnPatch(Session::TokenType token, const UserPatch& patch)
 {
-    auto session = validateWithPermission(token, Permission::Superuser);
+    auto session = sessionManager->validate(token);
     if(!session)
         return Error(session.error());
 
-    auto user = userManager->getUser(id);
+    const User* user = (*session)->getUser();
     if(!user)
         return Error(AuthenticationError::IntegrityFailure);
 
-    User updatedUser = **user;
-
-    updatedUser.setPermission(newPermission);
+    // The permission can only be changed by a superuser.
+    if(patch.permission)
+        return Error(AuthenticationError::InsufficientPermissions);
 
-    return userManager->updateUser(updatedUser);
+    return userManager->patchUser(user->getId(), patch);
 }
@@ -0,0 +1,136 @@
+#include "authentication_metrics.hpp"
+
+#include <bit>
+#include <limits>
+
+void LatencyHistogram::record(uint32_t nanoseconds)
+{
+    counts[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t currentMax = max.load(std::memory_order_relaxed);
+    while(nanoseconds > currentMax && !max.compare_exchange_weak(currentMax, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+void LatencyHistogram::takeSnapshot(Snapshot& snapshot) const
+{
+    // Values recorded meanwhile may be missing from some fields, the buckets stay consistent with each other.
+    for(size_t bucket = 0; bucket < BucketsAmount; bucket++)
+        snapshot.counts[bucket] = counts[bucket].load(std::memory_order_relaxed);
+
+    snapshot.count = count.load(std::memory_order_relaxed);
+    snapshot.max = max.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for(auto& bucketCount : counts)
+        bucketCount.store(0, std::memory_order_relaxed);
+
+    count.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::getBucket(uint32_t nanoseconds)
+{
+    if(nanoseconds < SubBuckets)
+        return nanoseconds;
+
+    // The two bits after the highest one select the sub-bucket.
+    size_t exponent = std::bit_width(nanoseconds) - 1;
+    size_t subBucket = (nanoseconds >> (exponent - 2)) & (SubBuckets - 1);
+    return SubBuckets + (exponent - 2) * SubBuckets + subBucket;
+}
+
+uint32_t LatencyHistogram::getBucketUpperBound(size_t bucket)
+{
+    if(bucket < SubBuckets)
+        return bucket;
+
+    size_t exponent = (bucket - SubBuckets) / SubBuckets + 2;
+    uint64_t subBucket = (bucket - SubBuckets) % SubBuckets;
+    uint64_t upperBound = ((SubBuckets + subBucket + 1) << (exponent - 2)) - 1;
+    return std::min<uint64_t>(upperBound, std::numeric_limits<uint32_t>::max());
+}
+
+uint32_t LatencyHistogram::Snapshot::getPercentile(double percentile) const
+{
+    uint32_t total = 0;
+    for(uint32_t bucketCount : counts)
+        total += bucketCount;
+
+    if(total == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(percentile * total);
+    uint64_t seen = 0;
+    for(size_t bucket = 0; bucket < BucketsAmount; bucket++)
+    {
+        seen += counts[bucket];
+        if(seen > rank)
+            return std::min(getBucketUpperBound(bucket), max);
+    }
+
+    return max;
+}
+
+MetricsTimer::MetricsTimer()
+    : start(std::chrono::steady_clock::now())
+{}
+
+uint32_t MetricsTimer::getElapsed() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return std::min<uint64_t>(elapsed, std::numeric_limits<uint32_t>::max());
+}
+
+void AuthenticationMetrics::record(Operation operation, uint32_t nanoseconds)
+{
+    operations.record(std::to_underlying(operation), nanoseconds, false);
+}
+
+void AuthenticationMetrics::record(Operation operation, uint32_t nanoseconds, AuthenticationError error)
+{
+    operations.record(std::to_underlying(operation), nanoseconds, true);
+    errors[std::to_underlying(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void AuthenticationMetrics::takeSnapshot(Snapshot& snapshot) const
+{
+    operations.takeSnapshot(snapshot.operations);
+    for(size_t error = 0; error < ErrorsAmount; error++)
+        snapshot.errors[error] = errors[error].load(std::memory_order_relaxed);
+}
+
+void AuthenticationMetrics::reset()
+{
+    operations.reset();
+    for(auto& errorCount : errors)
+        errorCount.store(0, std::memory_order_relaxed);
+}
+
+const char* AuthenticationMetrics::getName(Operation operation)
+{
+    switch(operation)
+    {
+        case Operation::Authenticate: return "Authenticate";
+        case Operation::Validate: return "Validate";
+        case Operation::ValidateWithPermission: return "ValidateWithPermission";
+        case Operation::UpdateSessions: return "UpdateSessions";
+        case Operation::CreateUser: return "CreateUser";
+        case Operation::CreateUsers: return "CreateUsers";
+        case Operation::DeleteUser: return "DeleteUser";
+        case Operation::LogOut: return "LogOut";
+        case Operation::ModifyOwnUsername: return "ModifyOwnUsername";
+        case Operation::ModifyOwnPassword: return "ModifyOwnPassword";
+        case Operation::ModifyOwnName: return "ModifyOwnName";
+        case Operation::ModifyOwnUser: return "ModifyOwnUser";
+        case Operation::ModifyUsername: return "ModifyUsername";
+        case Operation::ModifyPassword: return "ModifyPassword";
+        case Operation::ModifyName: return "ModifyName";
+        case Operation::ModifyPermission: return "ModifyPermission";
+        case Operation::ModifyUser: return "ModifyUser";
+        default: return "";
+    }
+}
@@ -0,0 +1,152 @@
+#include "login_throttle.hpp"
+#include "crc.hpp"
+
+#include <algorithm>
+
+LoginThrottle::LoginThrottle(std::span<Entry> entriesStorage, const Clock& clock)
+    : entries(entriesStorage), clock(&clock)
+{}
+
+void LoginThrottle::setPolicy(const Policy& newPolicy)
+{
+    policy = newPolicy;
+}
+
+ResultVoid LoginThrottle::check(std::string_view username, std::optional<ChannelId> channel) const
+{
+    if(getBlockedSeconds(username, channel))
+        return Error(AuthenticationError::Throttled);
+
+    return {};
+}
+
+void LoginThrottle::recordFailure(std::string_view username, std::optional<ChannelId> channel)
+{
+    uint32_t currentTime = clock->getTime();
+
+    Entry& userEntry = acquire(Entry::Kind::Username, getKey(username), currentTime);
+    addFailure(userEntry, currentTime);
+
+    if(!channel)
+        return;
+
+    // Both failing into the overflow entry is still a single failure.
+    Entry& channelEntry = acquire(Entry::Kind::Channel, *channel, currentTime);
+    if(&channelEntry != &userEntry)
+        addFailure(channelEntry, currentTime);
+}
+
+void LoginThrottle::recordSuccess(std::string_view username)
+{
+    if(Entry* entry = find(Entry::Kind::Username, getKey(username)))
+        *entry = Entry{};
+}
+
+uint32_t LoginThrottle::getBlockedSeconds(std::string_view username, std::optional<ChannelId> channel) const
+{
+    uint32_t currentTime = clock->getTime();
+
+    uint32_t seconds = getBlockedSeconds(findBlocking(Entry::Kind::Username, getKey(username), currentTime), currentTime);
+    if(channel)
+        seconds = std::max(seconds, getBlockedSeconds(findBlocking(Entry::Kind::Channel, *channel, currentTime), currentTime));
+
+    return seconds;
+}
+
+uint32_t LoginThrottle::getKey(std::string_view username)
+{
+    return Crc32::compute(std::span(reinterpret_cast<const uint8_t*>(username.data()), username.size()));
+}
+
+LoginThrottle::Entry* LoginThrottle::find(Entry::Kind kind, uint32_t key)
+{
+    auto findLambda = [&](const Entry& entry) {return entry.kind == kind && entry.key == key;};
+    auto it = std::find_if(entries.begin(), entries.end(), findLambda);
+
+    return it == entries.end() ? nullptr : &*it;
+}
+
+const LoginThrottle::Entry* LoginThrottle::find(Entry::Kind kind, uint32_t key) const
+{
+    return const_cast<LoginThrottle*>(this)->find(kind, key);
+}
+
+uint32_t LoginThrottle::getBlockedSeconds(const Entry* entry, uint32_t currentTime) const
+{
+    if(!entry || entry->blockedUntil <= currentTime)
+        return 0;
+
+    return entry->blockedUntil - currentTime;
+}
+
+LoginThrottle::Entry* LoginThrottle::findReplaceable(uint32_t currentTime)
+{
+    // Entries with failures that aren't forgotten yet are never replaced, or failing
+    // with many usernames would reset the count of the one being guessed.
+    Entry* replaced = nullptr;
+    for(Entry& entry : entries)
+    {
+        if(entry.kind == Entry::Kind::Free)
+            return &entry;
+
+        if(entry.blockedUntil > currentTime || currentTime - entry.lastFailure < policy.forgetSeconds)
+            continue;
+
+        if(!replaced || entry.lastFailure < replaced->lastFailure)
+            replaced = &entry;
+    }
+
+    return replaced;
+}
+
+const LoginThrottle::Entry* LoginThrottle::findReplaceable(uint32_t currentTime) const
+{
+    return const_cast<LoginThrottle*>(this)->findReplaceable(currentTime);
+}
+
+const LoginThrottle::Entry* LoginThrottle::findBlocking(Entry::Kind kind, uint32_t key, uint32_t currentTime) const
+{
+    if(const Entry* entry = find(kind, key))
+        return entry;
+
+    // A key that would get an entry on its first failure has no failures counted yet.
+    return findReplaceable(currentTime) ? nullptr : &overflow;
+}
+
+LoginThrottle::Entry& LoginThrottle::acquire(Entry::Kind kind, uint32_t key, uint32_t currentTime)
+{
+    if(Entry* entry = find(kind, key))
+        return *entry;
+
+    // A failure that isn't counted anywhere would let filling the table disable the throttle.
+    Entry* replaced = findReplaceable(currentTime);
+    if(!replaced)
+        return overflow;
+
+    *replaced = Entry{.kind = kind, .key = key};
+    return *replaced;
+}
+
+void LoginThrottle::addFailure(Entry& entry, uint32_t currentTime)
+{
+    if(entry.failures && currentTime - entry.lastFailure >= policy.forgetSeconds && entry.blockedUntil <= currentTime)
+        entry.failures = 0;
+
+    if(entry.failures < UINT8_MAX)
+        entry.failures++;
+    entry.lastFailure = currentTime;
+
+    // The overflow entry is shared by every key without an entry, locking it out would lock them all out.
+    uint32_t blockSeconds = 0;
+    if(policy.lockoutFailures && entry.failures >= policy.lockoutFailures && &entry != &overflow)
+        blockSeconds = policy.lockoutSeconds;
+    else if(entry.failures > policy.freeAttempts)
+    {
+        uint32_t doublings = std::min<uint32_t>(entry.failures - policy.freeAttempts - 1, 31);
+        uint64_t delay = static_cast<uint64_t>(policy.baseBlockSeconds) << doublings;
+        blockSeconds = std::min<uint64_t>(delay, policy.maxBlockSeconds);
+    }
+
+    if(blockSeconds)
+        entry.blockedUntil = std::max(entry.blockedUntil, currentTime + blockSeconds);
+}
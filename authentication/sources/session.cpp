@@ -1,20 +1,22 @@
 #include "session.hpp"
 
-#include <random>
-
-Session::Session(const User& user, uint32_t validitySeconds, uint32_t currentTime)
+Session::Session(const User& user, TokenType token, uint32_t validitySeconds, uint32_t currentTime)
 {
-    start(user, validitySeconds, currentTime);
+    start(user, token, validitySeconds, currentTime);
 }
 
-void Session::start(const User& user, uint32_t validitySeconds, uint32_t currentTime)
+void Session::start(const User& user, TokenType token, uint32_t validitySeconds, uint32_t currentTime)
 {
     this->user = &user;
+    this->token = token;
     expireTime = currentTime + validitySeconds;
+}
 
-    static std::mt19937_64 rng{std::random_device{}()};
-    std::uniform_int_distribution<TokenType> dist;
-    token = dist(rng);
+void Session::restore(const User& user, TokenType token, uint32_t expireTime)
+{
+    this->user = &user;
+    this->token = token;
+    this->expireTime = expireTime;
 }
 
 const User* Session::getUser() const
@@ -27,6 +29,11 @@ Session::TokenType Session::getToken() const
     return token;
 }
 
+uint32_t Session::getExpireTime() const
+{
+    return expireTime;
+}
+
 bool Session::isExpired() const
 {
     return !expireTime || !user || !token;
@@ -34,10 +41,15 @@ bool Session::isExpired() const
 
 void Session::update(uint32_t currentTime)
 {
-    if(currentTime < expireTime)
+    if(currentTime >= expireTime)
         expire();
 }
 
+void Session::extend(uint32_t newExpireTime)
+{
+    expireTime = newExpireTime;
+}
+
 void Session::expire()
 {
     user = nullptr;
@@ -1,16 +1,24 @@
 #include "session_manager.hpp"
 
-#include <stdexcept>
 #include <algorithm>
 
 ResultSession SessionManager::validate(Session::TokenType token)
 {
+    // Free sessions have a zero token, which must not match.
+    if(!token)
+        return Error(AuthenticationError::InvalidToken);
+
     auto findLambda = [&](const Session* session) {return session->getToken() == token;};
     auto it = std::find_if(sessions.begin(), sessions.end(), findLambda);
 
     if(it == sessions.end())
         return Error(AuthenticationError::InvalidToken);
 
+    uint32_t time = clock->getTime();
+    if(time >= (*it)->getExpireTime())
+        return Error(AuthenticationError::InvalidToken);
+
+    renewSession(**it, time);
     return *it;
 }
 
@@ -24,16 +32,51 @@ ResultSession SessionManager::createSession(const User& user)
     // Invalidate currently active session if there is one for the user.
     Session* session = getSessionByUser(user);
     if(session)
+    {
         session->expire();
+        refreshSession(session);
+    }
 
     session = getFreeSession();
     if(!session)
         return Error(AuthenticationError::SessionBufferFull);
 
-    session->start(user, sessionValiditySeconds, clock->getTime());
+    session->start(user, generateToken(), sessionValiditySeconds, clock->getTime());
+    refreshSession(session);
     return session;
 }
 
+ResultSession SessionManager::restoreSession(const User& user, Session::TokenType token, uint32_t expireTime)
+{
+    if(!token || expireTime <= clock->getTime())
+        return Error(AuthenticationError::InvalidToken);
+
+    Session* session = getSessionByUser(user);
+    if(session)
+    {
+        session->expire();
+        refreshSession(session);
+    }
+
+    session = getFreeSession();
+    if(!session)
+        return Error(AuthenticationError::SessionBufferFull);
+
+    session->restore(user, token, expireTime);
+    refreshSession(session);
+    return session;
+}
+
+Session::TokenType SessionManager::generateToken()
+{
+    Session::TokenType token;
+    do
+        token = tokenGenerator();
+    while(!token);
+
+    return token;
+}
+
 Session* SessionManager::getFreeSession()
 {
     auto findLambda = [&](const Session* session) {return session->isExpired();};
@@ -65,13 +108,50 @@ void SessionManager::expireSession(const Session& sessionToExpire)
         return;
 
     (*it)->expire();
+    refreshSession(*it);
 }
 
 void SessionManager::updateSessions()
 {
     auto time = clock->getTime();
     for(auto it = sessions.begin(); it != sessions.end(); it++)
+    {
+        bool wasExpired = (*it)->isExpired();
         (*it)->update(time);
+        if(!wasExpired && (*it)->isExpired())
+            refreshSession(*it);
+    }
+}
+
+void SessionManager::setSessionValiditySeconds(uint32_t seconds)
+{
+    sessionValiditySeconds = seconds;
+    renewalIntervalSeconds = std::min(renewalIntervalSeconds, getMaxRenewalIntervalSeconds());
+}
+
+void SessionManager::setRenewalIntervalSeconds(uint32_t seconds)
+{
+    renewalIntervalSeconds = std::min(seconds, getMaxRenewalIntervalSeconds());
+}
+
+uint32_t SessionManager::getMaxRenewalIntervalSeconds() const
+{
+    // A valid session has at least one second left, so at most validity - 1 seconds passed since its last renewal.
+    return sessionValiditySeconds ? sessionValiditySeconds - 1 : 0;
+}
+
+void SessionManager::renewSession(Session& session, uint32_t currentTime)
+{
+    if(!renewalIntervalSeconds)
+        return;
+
+    // Time since the last renewal, assuming it was extended to the current validity.
+    uint64_t remaining = session.getExpireTime() - currentTime;
+    if(remaining + renewalIntervalSeconds > sessionValiditySeconds)
+        return;
+
+    session.extend(currentTime + sessionValiditySeconds);
+    refreshSession(&session);
 }
 
 bool SessionManager::hasSession(const User& user) const
@@ -79,6 +159,21 @@ bool SessionManager::hasSession(const User& user) const
     return getSession(user) != nullptr;
 }
 
+std::span<const Session* const> SessionManager::getSessions() const
+{
+    return sessions;
+}
+
+void SessionManager::refreshSession(const Session* session)
+{
+    auto it = std::find(sessions.begin(), sessions.end(), session);
+    if(it != sessions.end())
+        sessionChanged(it - sessions.begin());
+}
+
+void SessionManager::sessionChanged(size_t)
+{}
+
 SessionManager::SessionManager(std::span<Session*> sessionsStorage, const Clock& clock)
-    : sessions(sessionsStorage), clock(&clock)
+    : sessions(sessionsStorage), clock(&clock), tokenGenerator(std::random_device{}())
 {}
\ No newline at end of file
@@ -1,8 +1,7 @@
 #include "user.hpp"
+#include "user_patch.hpp"
 
-#include <cstring>
 #include <algorithm>
-#include <stdexcept>
 
 User::User(std::span<char> usernameStorage, std::span<char> passwordStorage, std::span<char> nameStorage)
     : username(usernameStorage), password(passwordStorage), name(nameStorage), id(0), permission(Permission::None), valid(false)
@@ -14,22 +13,22 @@ User::User(std::span<char> usernameStorage, std::span<char> passwordStorage, std
 
 bool User::authenticate(std::string_view password) const
 {
-    return password == this->password.data();
+    return password == getPassword();
 }
 
 const std::string_view User::getUsername() const
 {
-    return getString(username);
+    return getString(username, usernameLength);
 }
 
 const std::string_view User::getPassword() const
 {
-    return getString(password);
+    return getString(password, passwordLength);
 }
 
 const std::string_view User::getName() const
 {
-    return getString(name);
+    return getString(name, nameLength);
 }
 
 User::IdType User::getId() const
@@ -97,25 +96,24 @@ bool User::isValid() const
     return valid;
 }
 
+bool User::isReserved() const
+{
+    return reserved;
+}
+
 ResultVoid User::setUsername(std::string_view newUsername)
 {
-    auto set = setString(newUsername, username);
-    if(!set)
-        return Error(AuthenticationError::UsernameBufferOverflow);
+    return setString(StringField::Username, newUsername);
 }
 
 ResultVoid User::setPassword(std::string_view newPassword)
 {
-    auto set = setString(newPassword, password);
-    if(!set)
-        return Error(AuthenticationError::PasswordBufferOverflow);
+    return setString(StringField::Password, newPassword);
 }
 
 ResultVoid User::setName(std::string_view newName)
 {
-    auto set = setString(newName, name);
-    if(!set)
-        return Error(AuthenticationError::NameBufferOverflow);
+    return setString(StringField::Name, newName);
 }
 
 void User::setId(User::IdType newId)
@@ -141,11 +139,78 @@ ResultVoid User::setBufferedFields(std::string_view username, std::string_view p
     set = setName(name);
     if(!set)
         return Error(set.error());
+
+    return {};
+}
+
+std::span<char> User::getUsernameStorage()
+{
+    return username;
+}
+
+std::span<char> User::getPasswordStorage()
+{
+    return password;
+}
+
+std::span<char> User::getNameStorage()
+{
+    return name;
+}
+
+ResultVoid User::setStoredFields(size_t newUsernameLength, size_t newPasswordLength, size_t newNameLength)
+{
+    auto set = setStoredString(StringField::Username, newUsernameLength);
+    if(!set)
+        return Error(set.error());
+
+    set = setStoredString(StringField::Password, newPasswordLength);
+    if(!set)
+        return Error(set.error());
+
+    set = setStoredString(StringField::Name, newNameLength);
+    if(!set)
+        return Error(set.error());
+
+    return {};
+}
+
+ResultVoid User::checkPatch(const UserPatch& patch) const
+{
+    if(patch.username && patch.username->empty())
+        return Error(AuthenticationError::EmptyMandatoryField);
+
+    if(patch.password && patch.password->empty())
+        return Error(AuthenticationError::EmptyMandatoryField);
+
+    return checkStrings(patch);
+}
+
+void User::applyPatch(const UserPatch& patch)
+{
+    if(patch.username)
+        (void)setString(StringField::Username, *patch.username);
+
+    if(patch.password)
+        (void)setString(StringField::Password, *patch.password);
+
+    if(patch.name)
+        (void)setString(StringField::Name, *patch.name);
+
+    if(patch.permission)
+        permission = *patch.permission;
 }
 
 void User::makeValid()
 {
     valid = true;
+    reserved = false;
+}
+
+ResultVoid User::reserve()
+{
+    reserved = true;
+    return {};
 }
 
 
@@ -154,34 +219,116 @@ void User::reset()
     id = 0;
     permission = Permission::None;
     valid = false;
+    reserved = false;
 
-    username[0] = '\0';
-    name[0] = '\0';
-    password[0] = '\0';
+    releaseStrings();
+    usernameLength = 0;
+    passwordLength = 0;
+    nameLength = 0;
+}
+
+std::span<char>& User::getStorage(StringField field)
+{
+    switch(field)
+    {
+        case StringField::Username:
+            return username;
+        case StringField::Password:
+            return password;
+        default:
+            return name;
+    }
+}
+
+size_t& User::getLength(StringField field)
+{
+    switch(field)
+    {
+        case StringField::Username:
+            return usernameLength;
+        case StringField::Password:
+            return passwordLength;
+        default:
+            return nameLength;
+    }
 }
 
-ResultVoid User::setString(std::string_view stringValue, std::span<char> storage)
+AuthenticationError User::getOverflowError(StringField field)
 {
-    if(stringValue.length() >= storage.size())
-        return Error(AuthenticationError::Overflow);
+    switch(field)
+    {
+        case StringField::Username:
+            return AuthenticationError::UsernameBufferOverflow;
+        case StringField::Password:
+            return AuthenticationError::PasswordBufferOverflow;
+        default:
+            return AuthenticationError::NameBufferOverflow;
+    }
+}
+
+ResultVoid User::setString(StringField field, std::string_view stringValue)
+{
+    auto prepared = prepareString(field, stringValue.length());
+    if(!prepared)
+        return Error(prepared.error());
 
+    std::span<char> storage = getStorage(field);
     std::copy(stringValue.begin(), stringValue.end(), storage.begin());
     storage[stringValue.length()] = '\0';
+    getLength(field) = stringValue.length();
+    return {};
 }
 
-std::string_view User::getString(std::span<char> storage)
+ResultVoid User::setStoredString(StringField field, size_t newLength)
+{
+    auto prepared = prepareString(field, newLength);
+    if(!prepared)
+        return Error(prepared.error());
+
+    getStorage(field)[newLength] = '\0';
+    getLength(field) = newLength;
+    return {};
+}
+
+std::string_view User::getString(std::span<char> storage, size_t length)
 {
-    auto stringLength = std::strlen(storage.data());
-    auto maxSize = storage.size();
-    auto length = std::min(stringLength, maxSize);
     return std::string_view(storage.data(), length);
 }
 
+ResultVoid User::prepareString(StringField field, size_t length)
+{
+    if(length >= getStorage(field).size())
+        return Error(getOverflowError(field));
+
+    return {};
+}
+
+ResultVoid User::checkStrings(const UserPatch& patch) const
+{
+    if(patch.username && patch.username->length() >= username.size())
+        return Error(AuthenticationError::UsernameBufferOverflow);
+
+    if(patch.password && patch.password->length() >= password.size())
+        return Error(AuthenticationError::PasswordBufferOverflow);
+
+    if(patch.name && patch.name->length() >= name.size())
+        return Error(AuthenticationError::NameBufferOverflow);
+
+    return {};
+}
+
+void User::releaseStrings()
+{
+    username[0] = '\0';
+    name[0] = '\0';
+    password[0] = '\0';
+}
+
 bool User::operator==(const User& other) const {
     return
         id == other.id &&
-        std::string_view(username) == std::string_view(other.username) &&
-        std::string_view(password) == std::string_view(other.password) &&
-        std::string_view(name) == std::string_view(other.name) &&
+        getUsername() == other.getUsername() &&
+        getPassword() == other.getPassword() &&
+        getName() == other.getName() &&
         permission == other.permission;
 }
\ No newline at end of file
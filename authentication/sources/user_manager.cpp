@@ -1,28 +1,182 @@
 #include "user_manager.hpp"
 
-#include <stdexcept>
+#include <limits>
 #include <algorithm>
 
 ResultUser UserManager::createUser(Permission newPermission, std::string_view newUsername, std::string_view newPassword, std::string_view newName)
 {
-    User* newUser = getFreeUser();
-    if(!newUser)
+    size_t slot = findFree();
+    if(slot == NoSlot)
         return Error(AuthenticationError::UsersBufferFull);
 
     if(usernameExists(newUsername))
         return Error(AuthenticationError::UsernameAlreadyExists);
 
+    auto id = getNextId();
+    if(!id)
+        return Error(id.error());
 
-    newUser->setPermission(newPermission);
-    newUser->setId(idCounter++);
-    auto set = newUser->setBufferedFields(newUsername, newPassword, newName);
+    return createUserInSlot(slot, *id, UserSpec{newPermission, newUsername, newPassword, newName});
+}
+
+size_t UserManager::createUsers(std::span<const UserSpec> specs, std::span<ResultUser> results)
+{
+    size_t amount = std::min(specs.size(), results.size());
+    size_t created = 0;
+
+    // Without the metadata arrays there's nothing cheaper than creating them one by one.
+    if(states.empty())
+    {
+        for(size_t index = 0; index < amount; index++)
+        {
+            const UserSpec& spec = specs[index];
+            results[index] = createUser(spec.permission, spec.username, spec.password, spec.name);
+            created += results[index].has_value();
+        }
+
+        return created;
+    }
+
+    // A single pass collects a filter of the username hashes in use, so only usernames
+    // whose bit is set are searched, and whether the ids from idCounter on are unused.
+    constexpr size_t FilterBits = 4096;
+    std::array<uint64_t, FilterBits / 64> filter{};
+    auto addToFilter = [&](uint32_t hash) {filter[hash % FilterBits / 64] |= uint64_t{1} << (hash % 64);};
+    auto isInFilter = [&](uint32_t hash) {return (filter[hash % FilterBits / 64] >> (hash % 64)) & 1;};
+
+    bool idsFree = true;
+    for(size_t slot = 0; slot < users.size(); slot++)
+    {
+        if(states[slot] != SlotState::Valid)
+            continue;
+
+        addToFilter(usernameHashes[slot]);
+        if(ids[slot] >= idCounter)
+            idsFree = false;
+    }
+
+    size_t freeSlot = 0;
+    for(size_t index = 0; index < amount; index++)
+    {
+        const UserSpec& spec = specs[index];
+
+        uint32_t hash = hashUsername(spec.username);
+        if(isInFilter(hash) && usernameExists(spec.username))
+        {
+            results[index] = Error(AuthenticationError::UsernameAlreadyExists);
+            continue;
+        }
+
+        while(freeSlot < users.size() && states[freeSlot] != SlotState::Free)
+            freeSlot++;
+
+        if(freeSlot == users.size())
+        {
+            results[index] = Error(AuthenticationError::UsersBufferFull);
+            continue;
+        }
+
+        Result<User::IdType> id = idsFree ? idCounter++ : getNextId();
+        // Once the counter wraps around, the ids from zero may be in use.
+        if(idCounter == 0)
+            idsFree = false;
+
+        if(!id)
+        {
+            results[index] = Error(id.error());
+            continue;
+        }
+
+        results[index] = createUserInSlot(freeSlot, *id, spec);
+        if(!results[index])
+            continue;
+
+        addToFilter(hash);
+        created++;
+    }
+
+    return created;
+}
+
+Result<User*> UserManager::reserveUser()
+{
+    size_t slot = findFree();
+    if(slot == NoSlot)
+        return Error(AuthenticationError::UsersBufferFull);
+
+    User* newUser = users[slot];
+    auto reserved = newUser->reserve();
+    refreshSlot(slot, Mutation::Reserved, 0);
+    if(!reserved)
+        return Error(reserved.error());
+
+    return newUser;
+}
+
+ResultUser UserManager::commitUser(User& reservedUser, Permission newPermission, size_t usernameLength, size_t passwordLength, size_t nameLength)
+{
+    if(!reservedUser.isReserved())
+        return Error(AuthenticationError::IntegrityFailure);
+
+    auto set = reservedUser.setStoredFields(usernameLength, passwordLength, nameLength);
     if(!set)
         return Error(set.error());
 
-    newUser->makeValid();
+    if(usernameExists(reservedUser.getUsername()))
+        return Error(AuthenticationError::UsernameAlreadyExists);
+
+    auto id = getNextId();
+    if(!id)
+        return Error(id.error());
+
+    reservedUser.setPermission(newPermission);
+    reservedUser.setId(*id);
+    reservedUser.makeValid();
+    refreshSlot(findSlot(reservedUser), Mutation::Created, reservedUser.getId());
 
     loadedUsers++;
-    return newUser;
+    return &reservedUser;
+}
+
+void UserManager::releaseUser(User& reservedUser)
+{
+    if(!reservedUser.isReserved())
+        return;
+
+    reservedUser.reset();
+    refreshSlot(findSlot(reservedUser), Mutation::Released, 0);
+}
+
+ResultUser UserManager::restoreUser(User::IdType id, Permission permission, std::string_view username, std::string_view password, std::string_view name)
+{
+    size_t slot = findId(id);
+    bool created = slot == NoSlot;
+    if(created)
+        slot = findFree();
+    if(slot == NoSlot)
+        return Error(AuthenticationError::UsersBufferFull);
+
+    size_t owner = findUsername(username);
+    if(owner != NoSlot && owner != slot)
+        return Error(AuthenticationError::UsernameAlreadyExists);
+
+    User* user = users[slot];
+    UserPatch patch{.username = username, .password = password, .name = name, .permission = permission};
+    auto checked = user->checkPatch(patch);
+    if(!checked)
+        return Error(checked.error());
+
+    user->applyPatch(patch);
+    user->setId(id);
+    user->makeValid();
+    refreshSlot(slot, created ? Mutation::Created : Mutation::Updated, id);
+
+    if(created)
+        loadedUsers++;
+    if(id >= idCounter)
+        idCounter = id + 1;
+
+    return user;
 }
 
 ResultUser UserManager::getUser(std::string_view username) const
@@ -35,50 +189,71 @@ ResultUser UserManager::getUser(User::IdType id) const
     return getUserById(id);
 }
 
-Result<User*> UserManager::getUserByUsername(std::string_view username) const
+Result<size_t> UserManager::getSlot(const User& user) const
 {
-    auto findLambda = [&](const User* user) {return user && user->getUsername() == username;};
-    auto it = std::find_if(users.begin(), users.end(), findLambda);
+    size_t slot = findSlot(user);
+    if(slot == NoSlot || !user.isValid())
+        return Error(AuthenticationError::UserIdNotFound);
 
-    if(it == users.end())
+    return slot;
+}
+
+ResultUser UserManager::getUserInSlot(size_t slot) const
+{
+    if(slot >= users.size() || !users[slot] || !users[slot]->isValid())
+        return Error(AuthenticationError::UserIdNotFound);
+
+    return users[slot];
+}
+
+Result<User*> UserManager::getUserByUsername(std::string_view username) const
+{
+    size_t slot = findUsername(username);
+    if(slot == NoSlot)
         return Error(AuthenticationError::UsernameNotFound);
 
-    return *it;
+    return users[slot];
 }
 
 Result<User*> UserManager::getUserById(User::IdType id) const
 {
-    auto findLambda = [&](const User* user) {return user && user->getId() == id;};
-    auto it = std::find_if(users.begin(), users.end(), findLambda);
-
-    if(it == users.end())
+    size_t slot = findId(id);
+    if(slot == NoSlot)
         return Error(AuthenticationError::UserIdNotFound);
 
-    return *it;
+    return users[slot];
 }
 
 ResultVoid UserManager::updateUser(User& updatedUser)
 {
-    if(updatedUser.getPassword().empty() || updatedUser.getUsername().empty())
-        return Error(AuthenticationError::EmptyMandatoryField);
+    return patchUser(updatedUser.getId(), UserPatch{
+        .username = updatedUser.getUsername(),
+        .password = updatedUser.getPassword(),
+        .name = updatedUser.getName(),
+        .permission = updatedUser.getPermission(),
+    });
+}
 
-    auto userResult = getUserById(updatedUser.getId());
-    if(!userResult)
-        return Error(userResult.error());
+ResultVoid UserManager::patchUser(User::IdType id, const UserPatch& patch)
+{
+    size_t slot = findId(id);
+    if(slot == NoSlot)
+        return Error(AuthenticationError::UserIdNotFound);
 
-    auto user = *userResult;
+    User* user = users[slot];
 
-    if(user->getUsername() != updatedUser.getUsername())
+    auto checked = user->checkPatch(patch);
+    if(!checked)
+        return Error(checked.error());
+
+    if(patch.username && *patch.username != user->getUsername())
     {
-        if(getUserByUsername(updatedUser.getUsername()))
+        if(usernameExists(*patch.username))
             return Error(AuthenticationError::UsernameAlreadyExists);
     }
 
-    user->setPermission(updatedUser.getPermission());
-    auto set = updatedUser.setBufferedFields(updatedUser.getUsername(), updatedUser.getPassword(), updatedUser.getName());
-    if(!set)
-        return Error(set.error());
-
+    user->applyPatch(patch);
+    refreshSlot(slot, Mutation::Updated, id);
     return {};
 }
 
@@ -93,12 +268,12 @@ ResultVoid UserManager::deleteUser(std::string_view username)
 
 ResultVoid UserManager::deleteUser(User::IdType id)
 {
-    auto storedUser = getUserById(id);
-
-    if(!storedUser)
-        return Error(storedUser.error());
+    size_t slot = findId(id);
+    if(slot == NoSlot)
+        return Error(AuthenticationError::UserIdNotFound);
 
-    (*storedUser)->reset();
+    users[slot]->reset();
+    refreshSlot(slot, Mutation::Deleted, id);
     loadedUsers--;
 
     return {};
@@ -106,31 +281,171 @@ ResultVoid UserManager::deleteUser(User::IdType id)
 
 ResultVoid UserManager::deleteUser(const User& user)
 {
-    auto storedUser = getUserById(user.getId());
-
-    if(!storedUser || **storedUser != user)
+    User::IdType id = user.getId();
+    size_t slot = findId(id);
+    if(slot == NoSlot || *users[slot] != user)
         return Error(AuthenticationError::UserIdNotFound);
 
-    (*storedUser)->reset();
+    users[slot]->reset();
+    refreshSlot(slot, Mutation::Deleted, id);
     loadedUsers--;
 
     return {};
 }
 
-User::IdType UserManager::getMaxUsers()
+size_t UserManager::findUsers(Permission permission, std::span<User::IdType> foundIds) const
+{
+    size_t found = 0;
+    for(size_t slot = 0; slot < users.size() && found < foundIds.size(); slot++)
+    {
+        if(states.empty())
+        {
+            const User* user = users[slot];
+            if(user && user->isValid() && user->getPermission() == permission)
+                foundIds[found++] = user->getId();
+        }
+        else if(states[slot] == SlotState::Valid && permissions[slot] == permission)
+            foundIds[found++] = ids[slot];
+    }
+
+    return found;
+}
+
+size_t UserManager::getMaxUsers() const
 {
     return users.size();
 }
 
-User* UserManager::getFreeUser() const
+size_t UserManager::findUsername(std::string_view username) const
+{
+    if(states.empty())
+    {
+        auto findLambda = [&](const User* user) {return user && user->isValid() && user->getUsername() == username;};
+        auto it = std::find_if(users.begin(), users.end(), findLambda);
+        return it == users.end() ? NoSlot : it - users.begin();
+    }
+
+    // Only the slots whose hash matches are compared with the username.
+    uint32_t hash = hashUsername(username);
+    for(size_t slot = 0; slot < users.size(); slot++)
+        if(usernameHashes[slot] == hash && states[slot] == SlotState::Valid && users[slot]->getUsername() == username)
+            return slot;
+
+    return NoSlot;
+}
+
+size_t UserManager::findId(User::IdType id) const
+{
+    if(states.empty())
+    {
+        auto findLambda = [&](const User* user) {return user && user->isValid() && user->getId() == id;};
+        auto it = std::find_if(users.begin(), users.end(), findLambda);
+        return it == users.end() ? NoSlot : it - users.begin();
+    }
+
+    for(size_t slot = 0; slot < users.size(); slot++)
+        if(ids[slot] == id && states[slot] == SlotState::Valid)
+            return slot;
+
+    return NoSlot;
+}
+
+size_t UserManager::findFree() const
 {
-    auto findLambda = [&](const User* user) {return user && !user->isValid();};
-    auto it = std::find_if(users.begin(), users.end(), findLambda);
+    if(states.empty())
+    {
+        auto findLambda = [&](const User* user) {return user && !user->isValid() && !user->isReserved();};
+        auto it = std::find_if(users.begin(), users.end(), findLambda);
+        return it == users.end() ? NoSlot : it - users.begin();
+    }
+
+    auto it = std::find(states.begin(), states.end(), SlotState::Free);
+    return it == states.end() ? NoSlot : it - states.begin();
+}
 
-    if(it == users.end())
-        return nullptr;
+Result<User::IdType> UserManager::getNextId()
+{
+    // Callers have a free slot, so at most users.size() - 1 ids are taken and
+    // one of the next users.size() ids is free, if there are that many ids.
+    size_t candidates = std::min(users.size(), size_t{std::numeric_limits<User::IdType>::max()} + 1);
+    for(size_t tried = 0; tried < candidates; tried++)
+    {
+        User::IdType id = idCounter++;
+        if(findId(id) == NoSlot)
+            return id;
+    }
 
-    return *it;
+    return Error(AuthenticationError::UsersBufferFull);
+}
+
+ResultUser UserManager::createUserInSlot(size_t slot, User::IdType id, const UserSpec& spec)
+{
+    User* newUser = users[slot];
+    newUser->setPermission(spec.permission);
+    newUser->setId(id);
+    auto set = newUser->setBufferedFields(spec.username, spec.password, spec.name);
+    if(!set)
+    {
+        newUser->reset();
+        return Error(set.error());
+    }
+
+    newUser->makeValid();
+    refreshSlot(slot, Mutation::Created, id);
+
+    loadedUsers++;
+    return newUser;
+}
+
+size_t UserManager::findSlot(const User& user) const
+{
+    auto it = std::find(users.begin(), users.end(), &user);
+    return it == users.end() ? NoSlot : it - users.begin();
+}
+
+void UserManager::refreshSlot(size_t slot, Mutation mutation, User::IdType id)
+{
+    if(slot == NoSlot)
+        return;
+
+    mirrorSlot(slot);
+    userChanged(slot, mutation, id);
+}
+
+void UserManager::userChanged(size_t, Mutation, User::IdType)
+{}
+
+void UserManager::mirrorSlot(size_t slot)
+{
+    if(states.empty())
+        return;
+
+    const User* user = users[slot];
+    if(!user)
+        return;
+
+    if(user->isValid())
+        states[slot] = SlotState::Valid;
+    else if(user->isReserved())
+        states[slot] = SlotState::Reserved;
+    else
+        states[slot] = SlotState::Free;
+
+    ids[slot] = user->getId();
+    permissions[slot] = user->getPermission();
+    usernameHashes[slot] = hashUsername(user->getUsername());
+}
+
+uint32_t UserManager::hashUsername(std::string_view username)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for(char character : username)
+    {
+        hash ^= static_cast<uint8_t>(character);
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
 bool UserManager::usernameExists(std::string_view username) const
@@ -140,4 +455,11 @@ bool UserManager::usernameExists(std::string_view username) const
 
 UserManager::UserManager(std::span<User*> usersStorage)
     : users(usersStorage)
-{}
\ No newline at end of file
+{}
+
+UserManager::UserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                         std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage)
+    : users(usersStorage), ids(idsStorage), permissions(permissionsStorage), states(statesStorage), usernameHashes(usernameHashesStorage)
+{
+    std::fill(states.begin(), states.end(), SlotState::Free);
+}
\ No newline at end of file
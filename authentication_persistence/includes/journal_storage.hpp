@@ -0,0 +1,69 @@
+#pragma once
+
+#include <span>
+#include <stdint.h>
+
+#include "authentication_errors.hpp"
+
+// Append-only byte storage used by the journal and its snapshots.
+class JournalStorage
+{
+    public:
+        virtual ~JournalStorage() = default;
+
+        virtual size_t size() const = 0;
+        // Returns the amount of bytes read, less than requested past the end.
+        virtual Result<size_t> read(size_t offset, std::span<uint8_t> bytes) = 0;
+        virtual ResultVoid append(std::span<const uint8_t> bytes) = 0;
+        virtual ResultVoid truncate(size_t newSize) = 0;
+        // Returns once every byte appended is durable.
+        virtual ResultVoid sync() = 0;
+};
+
+// Storage kept in a caller buffer, which survives a simulated power loss:
+// a new manager opened over the same buffer sees what was written before.
+class MemoryJournalStorage : public JournalStorage
+{
+    public:
+        MemoryJournalStorage(std::span<uint8_t> bufferStorage);
+
+        size_t size() const override;
+        Result<size_t> read(size_t offset, std::span<uint8_t> bytes) override;
+        ResultVoid append(std::span<const uint8_t> bytes) override;
+        ResultVoid truncate(size_t newSize) override;
+        ResultVoid sync() override;
+
+        // Simulates a torn write: once this many more bytes were appended, the rest
+        // of the appends are lost while still reported as written.
+        void tearAfter(size_t bytes);
+
+    protected:
+        std::span<uint8_t> buffer;
+        size_t length = 0;
+        size_t writesLeft = SIZE_MAX;
+};
+
+// Storage in a file, synced with fdatasync.
+class FileJournalStorage : public JournalStorage
+{
+    public:
+        FileJournalStorage() = default;
+        ~FileJournalStorage();
+
+        FileJournalStorage(const FileJournalStorage&) = delete;
+        FileJournalStorage& operator=(const FileJournalStorage&) = delete;
+
+        // Opens the file, creating it if it doesn't exist.
+        ResultVoid open(const char* path);
+        void close();
+
+        size_t size() const override;
+        Result<size_t> read(size_t offset, std::span<uint8_t> bytes) override;
+        ResultVoid append(std::span<const uint8_t> bytes) override;
+        ResultVoid truncate(size_t newSize) override;
+        ResultVoid sync() override;
+
+    protected:
+        int fd = -1;
+        size_t length = 0;
+};
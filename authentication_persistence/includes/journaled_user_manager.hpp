@@ -0,0 +1,117 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <stdint.h>
+
+#include "user.hpp"
+#include "user_manager.hpp"
+#include "journal_storage.hpp"
+
+// User manager that logs every mutation to an append-only journal and
+// recovers the users from it after a restart or a power loss.
+//
+// Mutations are buffered and written together by commit(), so a group of
+// changes costs a single sync. Once the journal grows past the compaction
+// threshold the users are written to a new snapshot and the journal starts
+// over. The two snapshot storages are used alternately, so the previous
+// snapshot stays valid until the new one was fully synced.
+//
+// Record:   Size (2 bytes) | Kind (1 byte) | Id (2 bytes) | Permission (1 byte) |
+//           Username '\0' Password '\0' Name '\0' | CRC-32 (4 bytes)
+// Journal:  Magic (4 bytes) | Generation (4 bytes) | Records
+// Snapshot: Records | Magic (4 bytes) | Generation (4 bytes) | Records size (4 bytes) | CRC-32 of the records (4 bytes)
+//
+// Size counts the bytes between itself and the CRC, and the CRC of a record
+// covers every byte before it. Delete records carry no strings. Permission
+// changes are stored as updates. Values are little endian.
+class JournaledUserManager : public UserManager
+{
+    public:
+        static constexpr std::array<uint8_t, 4> JournalMagic{'E', 'A', 'J', 'L'};
+        static constexpr std::array<uint8_t, 4> SnapshotMagic{'E', 'A', 'S', 'N'};
+
+        // The pending buffer holds the records until they're committed,
+        // it must fit a record with the longest strings.
+        JournaledUserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                             std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage, std::span<uint8_t> pendingStorage);
+
+        // Loads the newest valid snapshot and replays the journal records written after it.
+        // A torn record at the end of the journal is dropped. Must be called before the manager is used.
+        ResultVoid open(JournalStorage& snapshotStorage, JournalStorage& otherSnapshotStorage, JournalStorage& journalStorage);
+
+        // Writes and syncs the records of the mutations done since the last commit.
+        ResultVoid commit();
+        // Writes every user to a new snapshot and empties the journal.
+        ResultVoid compact();
+
+        void setCompactionThreshold(size_t journalBytes);
+        size_t getPendingBytes() const;
+
+        // True once a mutation couldn't be journaled since the manager was opened.
+        bool hasFailed() const;
+
+    protected:
+        enum class RecordKind : uint8_t
+        {
+            Create = 1,
+            Update,
+            Delete,
+        };
+
+        static constexpr size_t RecordHeaderSize = 6;
+        static constexpr size_t CrcSize = 4;
+        static constexpr size_t JournalHeaderSize = 8;
+        static constexpr size_t FooterSize = 16;
+
+        std::array<JournalStorage*, 2> snapshots{};
+        JournalStorage* journal = nullptr;
+        size_t activeSnapshot = 1;
+        uint32_t generation = 0;
+
+        std::span<uint8_t> pending;
+        size_t pendingLength = 0;
+        size_t compactionThreshold = SIZE_MAX;
+
+        bool replaying = false;
+        bool failed = false;
+
+        static size_t getRecordSize(const User* user);
+        static size_t encodeRecord(RecordKind kind, User::IdType id, const User* user, std::span<uint8_t> bytes);
+        ResultVoid applyRecord(std::span<const uint8_t> record);
+
+        // Adds a record to the pending buffer, committing first if it doesn't fit.
+        ResultVoid appendRecord(RecordKind kind, User::IdType id, const User* user);
+
+        // Generation of the snapshot, or an error if it isn't complete.
+        Result<uint32_t> checkSnapshot(JournalStorage& storage);
+        // Applies the valid records between begin and end, returns where they stop.
+        Result<size_t> replay(JournalStorage& storage, size_t begin, size_t end);
+        ResultVoid resetJournal();
+
+        void userChanged(size_t slot, Mutation mutation, User::IdType id) override;
+};
+
+template <size_t UsersAmount, size_t UsernameLength, size_t PasswordLength, size_t NameLength, size_t PendingSize = 1024>
+class StaticJournaledUserManager : public JournaledUserManager
+{
+    protected:
+        static_assert(PendingSize >= 6 + UsernameLength + PasswordLength + NameLength + 4);
+
+        typedef StaticUser<UsernameLength, PasswordLength, NameLength> UserType;
+        std::array<UserType, UsersAmount> usersStorage;
+        std::array<User*, UsersAmount> usersPointers;
+        std::array<User::IdType, UsersAmount> idsStorage;
+        std::array<Permission, UsersAmount> permissionsStorage;
+        std::array<SlotState, UsersAmount> statesStorage;
+        std::array<uint32_t, UsersAmount> usernameHashesStorage;
+        std::array<uint8_t, PendingSize> pendingStorage;
+
+    public:
+        StaticJournaledUserManager()
+            : JournaledUserManager(usersPointers, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage, pendingStorage)
+        {
+            for (size_t i = 0; i < UsersAmount; i++)
+                usersPointers[i] = &usersStorage[i];
+        };
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <span>
+#include <stdint.h>
+
+// Helpers for the little endian values of the persistence formats.
+
+inline void writeLittleEndian(std::span<uint8_t> bytes, uint64_t value)
+{
+    for(uint8_t& byte : bytes)
+    {
+        byte = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+inline uint64_t readLittleEndian(std::span<const uint8_t> bytes)
+{
+    uint64_t value = 0;
+    for(size_t i = bytes.size(); i > 0; i--)
+        value = (value << 8) | bytes[i - 1];
+
+    return value;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <stdint.h>
+
+#include "user.hpp"
+#include "user_manager.hpp"
+
+// User whose strings are stored in its slot of a memory-mapped file.
+class PersistentUser : public User
+{
+    public:
+        PersistentUser();
+
+        ResultVoid reserve() override;
+
+    protected:
+        friend class PersistentUserManager;
+
+        // The storage is empty while the manager isn't open, so nothing can be written.
+        bool isMapped() const;
+
+        ResultVoid prepareString(StringField field, size_t length) override;
+        ResultVoid checkStrings(const UserPatch& patch) const override;
+        void releaseStrings() override;
+};
+
+// User manager backed by a memory-mapped file with one fixed-size slot per user.
+// The strings of the users are read and written in place in the mapping, so
+// opening the file only reads the small header of each slot. Every change to a
+// user is synced to the file, only for the pages of its slot.
+//
+// File:  Header (64 bytes) | Slot 0 | Slot 1 | ...
+// Slot:  State (1 byte) | Permission (1 byte) | Id (2 bytes) | Username length (2 bytes) |
+//        Password length (2 bytes) | Name length (2 bytes) | Username | Password | Name
+//
+// Values are in the byte order of the host.
+class PersistentUserManager : public UserManager
+{
+    public:
+        static constexpr std::array<char, 8> Magic{'E', 'A', 'U', 'T', 'U', 'S', 'R', 'S'};
+        static constexpr uint32_t Version = 1;
+        static constexpr size_t HeaderSize = 64;
+
+        // Every user must be a PersistentUser.
+        PersistentUserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                              std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage,
+                              size_t usernameSize, size_t passwordSize, size_t nameSize);
+        ~PersistentUserManager();
+
+        PersistentUserManager(const PersistentUserManager&) = delete;
+        PersistentUserManager& operator=(const PersistentUserManager&) = delete;
+
+        // Maps the file, creating it if it doesn't exist. An existing file must have been
+        // created with the same amount of users and string sizes. Until it succeeds, and
+        // after close, every change to the users fails with StorageFailure.
+        ResultVoid open(const char* path);
+        void close();
+
+        // True once a change couldn't be synced to the file since it was opened.
+        bool hasFailed() const;
+
+    protected:
+        struct FileHeader
+        {
+            std::array<char, 8> magic;
+            uint32_t version;
+            uint32_t slotsAmount;
+            uint32_t slotSize;
+            uint16_t usernameSize;
+            uint16_t passwordSize;
+            uint16_t nameSize;
+        };
+
+        struct SlotHeader
+        {
+            uint8_t state;
+            uint8_t permission;
+            uint16_t id;
+            uint16_t usernameLength;
+            uint16_t passwordLength;
+            uint16_t nameLength;
+        };
+
+        static_assert(sizeof(FileHeader) <= HeaderSize);
+
+        int fd = -1;
+        std::span<char> mapping;
+        bool failed = false;
+
+        size_t usernameSize;
+        size_t passwordSize;
+        size_t nameSize;
+        size_t slotSize;
+
+        FileHeader makeHeader() const;
+        std::span<char> getSlot(size_t slot);
+
+        // Points the user to the strings in its slot and loads it if it's valid.
+        ResultVoid loadSlot(size_t slot);
+        void storeSlot(size_t slot);
+        ResultVoid sync(std::span<char> bytes);
+        void unmap();
+
+        void userChanged(size_t slot, Mutation mutation, User::IdType id) override;
+};
+
+template <size_t UsersAmount, size_t UsernameLength, size_t PasswordLength, size_t NameLength>
+class StaticPersistentUserManager : public PersistentUserManager
+{
+    protected:
+        std::array<PersistentUser, UsersAmount> usersStorage;
+        std::array<User*, UsersAmount> usersPointers;
+        std::array<User::IdType, UsersAmount> idsStorage;
+        std::array<Permission, UsersAmount> permissionsStorage;
+        std::array<SlotState, UsersAmount> statesStorage;
+        std::array<uint32_t, UsersAmount> usernameHashesStorage;
+
+    public:
+        StaticPersistentUserManager()
+            : PersistentUserManager(usersPointers, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage,
+                                    UsernameLength, PasswordLength, NameLength)
+        {
+            for (size_t i = 0; i < UsersAmount; i++)
+                usersPointers[i] = &usersStorage[i];
+        };
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+
+#include "user_manager.hpp"
+#include "session_manager.hpp"
+
+// Saves the live sessions to a file and restores them after a restart, so the
+// users don't have to log in again.
+//
+// File:    Magic (4 bytes) | Version (4 bytes) | Records amount (4 bytes) | CRC-32 of the records (4 bytes) | Records
+// Record:  Token (8 bytes) | Expire time (4 bytes) | User id (2 bytes) | CRC-32 of the username (4 bytes)
+//
+// The username checksum keeps a session from being given to a different user
+// that got the id of a deleted one. Values are little endian.
+class SessionSnapshot
+{
+    public:
+        static constexpr std::array<uint8_t, 4> Magic{'E', 'A', 'S', 'S'};
+        static constexpr uint32_t Version = 1;
+
+        // Writes the sessions of valid users to a temporary file, which then replaces the one at path.
+        static ResultVoid save(const SessionManager& sessionManager, const char* path);
+
+        // Restores the sessions whose user still exists and that didn't expire yet.
+        // Returns the amount of sessions restored.
+        static Result<size_t> restore(SessionManager& sessionManager, const UserManager& userManager, const char* path);
+
+    protected:
+        static constexpr size_t HeaderSize = 16;
+        static constexpr size_t RecordSize = 18;
+        // Records are read and written through a buffer of this many.
+        static constexpr size_t BufferedRecords = 32;
+};
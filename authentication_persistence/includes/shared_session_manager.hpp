@@ -0,0 +1,128 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+#include "user_manager.hpp"
+#include "session_manager.hpp"
+
+// Layout of the POSIX shared memory segment holding a table of sessions.
+// One process writes it and any amount of processes validate tokens in it.
+//
+// Segment: Header | Entry 0 | Entry 1 | ...
+//
+// Every entry is guarded by a sequence lock: the writer makes the sequence odd
+// while it changes the entry, readers retry when it was odd or changed while
+// they read. Readers never write to the segment. Users are referred to by the
+// index of their slot in the user manager of the writer, and by their id.
+class SharedSessionTable
+{
+    public:
+        static constexpr uint32_t Magic = 0x45415354;
+        static constexpr uint32_t Version = 1;
+
+    protected:
+        struct Header
+        {
+            // Written last by the writer, once the entries are initialized.
+            std::atomic<uint32_t> magic;
+            uint32_t version;
+            uint32_t capacity;
+        };
+
+        struct Entry
+        {
+            std::atomic<uint32_t> sequence;
+            std::atomic<uint32_t> expireTime;
+            std::atomic<uint64_t> token;
+            std::atomic<uint32_t> userSlot;
+            std::atomic<uint16_t> userId;
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free &&
+                      std::atomic<uint16_t>::is_always_lock_free, "Shared atomics must not rely on a lock");
+
+        static constexpr size_t EntriesOffset = (sizeof(Header) + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+
+        static size_t getSegmentSize(size_t capacity);
+};
+
+// Session manager that publishes its sessions in a shared memory table, so
+// other processes can validate the tokens with a SharedSessionReader.
+class SharedSessionManager : public SessionManager, protected SharedSessionTable
+{
+    public:
+        SharedSessionManager(std::span<Session*> sessionsStorage, const Clock& clock, const UserManager& userManager);
+        ~SharedSessionManager();
+
+        SharedSessionManager(const SharedSessionManager&) = delete;
+        SharedSessionManager& operator=(const SharedSessionManager&) = delete;
+
+        // Creates the segment with that name, replacing an existing one, and publishes the current sessions.
+        ResultVoid open(const char* name);
+        // Unmaps and removes the segment, readers that mapped it keep the last state.
+        void close();
+
+    protected:
+        const UserManager* userManager;
+
+        std::array<char, 256> segmentName{};
+        std::span<std::byte> mapping;
+        std::span<Entry> entries;
+
+        void publish(size_t index);
+
+        void sessionChanged(size_t index) override;
+};
+
+template <size_t SessionAmount>
+class StaticSharedSessionManager : public SharedSessionManager
+{
+    protected:
+        std::array<Session, SessionAmount> sessionStorage;
+        std::array<Session*, SessionAmount> sessionPointers;
+
+    public:
+        StaticSharedSessionManager(const Clock& clock, const UserManager& userManager)
+            : SharedSessionManager(sessionPointers, clock, userManager)
+        {
+            for (size_t i = 0; i < SessionAmount; i++)
+                sessionPointers[i] = &sessionStorage[i];
+        };
+};
+
+// Session found in a shared table.
+struct SharedSession
+{
+    Session::TokenType token;
+    uint32_t expireTime;
+    size_t userSlot;
+    User::IdType userId;
+};
+
+// Read-only view of a table published by a SharedSessionManager in another process.
+class SharedSessionReader : protected SharedSessionTable
+{
+    public:
+        SharedSessionReader(const Clock& clock);
+        ~SharedSessionReader();
+
+        SharedSessionReader(const SharedSessionReader&) = delete;
+        SharedSessionReader& operator=(const SharedSessionReader&) = delete;
+
+        // Fails until the writer finished creating the segment.
+        ResultVoid open(const char* name);
+        void close();
+
+        // Never blocks the writer. An entry that keeps changing while it's read is treated as invalid.
+        Result<SharedSession> validate(Session::TokenType token) const;
+
+    protected:
+        static constexpr size_t ReadAttempts = 64;
+
+        const Clock* clock;
+        std::span<const std::byte> mapping;
+        std::span<const Entry> entries;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string_view>
+#include <stdint.h>
+
+#include "user_manager.hpp"
+#include "journal_storage.hpp"
+
+// Moves the users of a manager between devices, as CSV or as compact binary
+// records. Both directions stream through a fixed buffer, so the size of the
+// table doesn't matter.
+//
+// CSV:     Header line "id,permission,username,name,password", then one line per user.
+//          Fields with commas, quotes or line breaks are quoted, doubling their quotes.
+// Binary:  Magic (4 bytes) | Version (4 bytes) | Records
+// Record:  Id (2 bytes) | Permission (1 byte) | Username length (2 bytes) | Name length (2 bytes) |
+//          Password length (2 bytes) | Username | Name | Password | CRC-32 of the record (4 bytes)
+//
+// Exports never contain credentials, the password is always empty. Imported
+// records with an empty password keep the password of the user that already has
+// their id and username, any other user gets the default one. Records written by
+// hand for provisioning keep their password. Values are little endian.
+class UserTransfer
+{
+    public:
+        enum class Format
+        {
+            Csv,
+            Binary,
+        };
+
+        static constexpr std::array<uint8_t, 4> Magic{'E', 'A', 'U', 'X'};
+        static constexpr uint32_t Version = 1;
+
+        // Longest string accepted in an imported record.
+        static constexpr size_t MaxStringSize = 255;
+
+        struct ImportSummary
+        {
+            size_t imported = 0;
+            // New users created with the default password, which should be changed.
+            size_t defaultPasswords = 0;
+        };
+
+        // Appends every valid user to the storage, which should be empty.
+        static ResultVoid exportUsers(const UserManager& userManager, JournalStorage& storage, Format format);
+
+        // Creates the users of the storage with their ids, overwriting the users that already have them.
+        // A username held by a user with another id is rejected, so no existing user gets the default password.
+        // Stops at the first record that is malformed or rejected by the manager, keeping the ones before.
+        static Result<ImportSummary> importUsers(UserManager& userManager, JournalStorage& storage, Format format, std::string_view defaultPassword);
+
+    protected:
+        static constexpr size_t BufferSize = 512;
+        static constexpr size_t BinaryHeaderSize = 8;
+        static constexpr size_t RecordHeaderSize = 9;
+        static constexpr size_t CsvFields = 5;
+
+        class Writer;
+        class Reader;
+
+        // Record read from the storage, its strings point to the buffers.
+        struct Record
+        {
+            User::IdType id;
+            Permission permission;
+            std::string_view username;
+            std::string_view name;
+            std::string_view password;
+
+            std::array<char, MaxStringSize> usernameBuffer;
+            std::array<char, MaxStringSize> nameBuffer;
+            std::array<char, MaxStringSize> passwordBuffer;
+        };
+
+        static void writeCsv(Writer& writer, const User& user);
+        static void writeCsvField(Writer& writer, std::string_view field);
+        static void writeBinary(Writer& writer, const User& user);
+
+        // Return false at the end of the storage, or an error if the record is malformed.
+        static Result<bool> readCsv(Reader& reader, Record& record);
+        static Result<bool> readCsvFields(Reader& reader, std::span<const std::span<char>> fields, std::span<size_t> lengths);
+        static Result<bool> readBinary(Reader& reader, Record& record);
+
+        static std::string_view getPermissionName(Permission permission);
+        static Result<Permission> parsePermission(std::string_view name);
+};
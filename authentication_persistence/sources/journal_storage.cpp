@@ -0,0 +1,152 @@
+#include "journal_storage.hpp"
+
+#include <cerrno>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+MemoryJournalStorage::MemoryJournalStorage(std::span<uint8_t> bufferStorage)
+    : buffer(bufferStorage)
+{}
+
+size_t MemoryJournalStorage::size() const
+{
+    return length;
+}
+
+Result<size_t> MemoryJournalStorage::read(size_t offset, std::span<uint8_t> bytes)
+{
+    if(offset >= length)
+        return 0;
+
+    size_t amount = std::min(bytes.size(), length - offset);
+    std::copy_n(buffer.begin() + offset, amount, bytes.begin());
+    return amount;
+}
+
+ResultVoid MemoryJournalStorage::append(std::span<const uint8_t> bytes)
+{
+    if(length + bytes.size() > buffer.size())
+        return Error(AuthenticationError::StorageFailure);
+
+    size_t amount = std::min(bytes.size(), writesLeft);
+    std::copy_n(bytes.begin(), amount, buffer.begin() + length);
+    length += amount;
+    if(writesLeft != SIZE_MAX)
+        writesLeft -= amount;
+
+    return {};
+}
+
+ResultVoid MemoryJournalStorage::truncate(size_t newSize)
+{
+    if(writesLeft == 0)
+        return {};
+
+    length = std::min(length, newSize);
+    return {};
+}
+
+ResultVoid MemoryJournalStorage::sync()
+{
+    return {};
+}
+
+void MemoryJournalStorage::tearAfter(size_t bytes)
+{
+    writesLeft = bytes;
+}
+
+FileJournalStorage::~FileJournalStorage()
+{
+    close();
+}
+
+ResultVoid FileJournalStorage::open(const char* path)
+{
+    close();
+
+    int newFd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(newFd < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    struct stat status;
+    if(fstat(newFd, &status) < 0)
+    {
+        ::close(newFd);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    fd = newFd;
+    length = status.st_size;
+    return {};
+}
+
+void FileJournalStorage::close()
+{
+    if(fd < 0)
+        return;
+
+    ::close(fd);
+    fd = -1;
+    length = 0;
+}
+
+size_t FileJournalStorage::size() const
+{
+    return length;
+}
+
+Result<size_t> FileJournalStorage::read(size_t offset, std::span<uint8_t> bytes)
+{
+    size_t done = 0;
+    while(done < bytes.size() && offset + done < length)
+    {
+        ssize_t received = pread(fd, bytes.data() + done, bytes.size() - done, offset + done);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received < 0)
+            return Error(AuthenticationError::StorageFailure);
+        if(received == 0)
+            break;
+        done += received;
+    }
+
+    return done;
+}
+
+ResultVoid FileJournalStorage::append(std::span<const uint8_t> bytes)
+{
+    size_t done = 0;
+    while(done < bytes.size())
+    {
+        ssize_t written = pwrite(fd, bytes.data() + done, bytes.size() - done, length + done);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written < 0)
+            return Error(AuthenticationError::StorageFailure);
+        done += written;
+    }
+
+    length += done;
+    return {};
+}
+
+ResultVoid FileJournalStorage::truncate(size_t newSize)
+{
+    if(ftruncate(fd, newSize) < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    length = newSize;
+    return {};
+}
+
+ResultVoid FileJournalStorage::sync()
+{
+    if(fdatasync(fd) < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    return {};
+}
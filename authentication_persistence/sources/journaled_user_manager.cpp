@@ -0,0 +1,408 @@
+#include "journaled_user_manager.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#include "crc.hpp"
+#include "little_endian.hpp"
+
+JournaledUserManager::JournaledUserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                                           std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage, std::span<uint8_t> pendingStorage)
+    : UserManager(usersStorage, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage),
+      pending(pendingStorage)
+{}
+
+ResultVoid JournaledUserManager::open(JournalStorage& snapshotStorage, JournalStorage& otherSnapshotStorage, JournalStorage& journalStorage)
+{
+    snapshots = {&snapshotStorage, &otherSnapshotStorage};
+    journal = nullptr;
+    pendingLength = 0;
+    failed = false;
+
+    // The newest complete snapshot wins, a torn one is ignored.
+    bool found = false;
+    activeSnapshot = 1;
+    generation = 0;
+    for(size_t i = 0; i < snapshots.size(); i++)
+    {
+        auto snapshotGeneration = checkSnapshot(*snapshots[i]);
+        if(!snapshotGeneration)
+        {
+            if(snapshotGeneration.error() != AuthenticationError::IntegrityFailure)
+                return Error(snapshotGeneration.error());
+            continue;
+        }
+
+        if(!found || *snapshotGeneration > generation)
+        {
+            found = true;
+            activeSnapshot = i;
+            generation = *snapshotGeneration;
+        }
+    }
+
+    replaying = true;
+
+    if(found)
+    {
+        JournalStorage& snapshot = *snapshots[activeSnapshot];
+        size_t recordsEnd = snapshot.size() - FooterSize;
+        auto replayed = replay(snapshot, 0, recordsEnd);
+        if(!replayed || *replayed != recordsEnd)
+        {
+            replaying = false;
+            return Error(replayed ? AuthenticationError::IntegrityFailure : replayed.error());
+        }
+    }
+
+    // The journal only continues the snapshot it was started after.
+    std::array<uint8_t, JournalHeaderSize> header{};
+    auto headerRead = journalStorage.read(0, header);
+    if(!headerRead)
+    {
+        replaying = false;
+        return Error(headerRead.error());
+    }
+
+    bool continues =
+        *headerRead == header.size() &&
+        std::equal(JournalMagic.begin(), JournalMagic.end(), header.begin()) &&
+        readLittleEndian(std::span(header).subspan(4)) == generation;
+
+    journal = &journalStorage;
+    ResultVoid recovered;
+    if(continues)
+    {
+        auto replayed = replay(journalStorage, JournalHeaderSize, journalStorage.size());
+        if(!replayed)
+            recovered = Error(replayed.error());
+        else if(*replayed != journalStorage.size())
+            recovered = journalStorage.truncate(*replayed);
+    }
+    else
+        recovered = resetJournal();
+
+    replaying = false;
+
+    if(!recovered)
+    {
+        journal = nullptr;
+        return Error(recovered.error());
+    }
+
+    return {};
+}
+
+ResultVoid JournaledUserManager::commit()
+{
+    if(!journal)
+        return Error(AuthenticationError::StorageFailure);
+
+    if(pendingLength > 0)
+    {
+        // A failed append is cut off, so that the records after it can still be read.
+        size_t previousSize = journal->size();
+        auto appended = journal->append(std::span(pending).first(pendingLength));
+        if(!appended)
+        {
+            static_cast<void>(journal->truncate(previousSize));
+            failed = true;
+            return Error(appended.error());
+        }
+
+        auto synced = journal->sync();
+        if(!synced)
+        {
+            failed = true;
+            return Error(synced.error());
+        }
+
+        pendingLength = 0;
+    }
+
+    if(journal->size() >= compactionThreshold)
+        return compact();
+
+    return {};
+}
+
+ResultVoid JournaledUserManager::compact()
+{
+    if(!journal)
+        return Error(AuthenticationError::StorageFailure);
+
+    if(pendingLength > 0)
+    {
+        auto committed = commit();
+        if(!committed)
+            return Error(committed.error());
+    }
+
+    // The pending buffer is empty, it's used to encode the records one at a time.
+    size_t target = 1 - activeSnapshot;
+    JournalStorage& snapshot = *snapshots[target];
+
+    auto truncated = snapshot.truncate(0);
+    if(!truncated)
+        return Error(truncated.error());
+
+    uint32_t crc = Crc32::Initial;
+    size_t recordsSize = 0;
+    for(const User* user : users)
+    {
+        if(!user->isValid())
+            continue;
+
+        size_t length = encodeRecord(RecordKind::Create, user->getId(), user, pending);
+        auto record = std::span<const uint8_t>(pending).first(length);
+        auto appended = snapshot.append(record);
+        if(!appended)
+            return Error(appended.error());
+
+        crc = Crc32::compute(record, crc);
+        recordsSize += length;
+    }
+
+    std::array<uint8_t, FooterSize> footer{};
+    std::copy(SnapshotMagic.begin(), SnapshotMagic.end(), footer.begin());
+    writeLittleEndian(std::span(footer).subspan(4, 4), generation + 1);
+    writeLittleEndian(std::span(footer).subspan(8, 4), recordsSize);
+    writeLittleEndian(std::span(footer).subspan(12, 4), crc);
+
+    auto appended = snapshot.append(footer);
+    if(!appended)
+        return Error(appended.error());
+
+    auto synced = snapshot.sync();
+    if(!synced)
+        return Error(synced.error());
+
+    // From here the new snapshot is the one loaded, the old journal is ignored.
+    activeSnapshot = target;
+    generation++;
+
+    return resetJournal();
+}
+
+void JournaledUserManager::setCompactionThreshold(size_t journalBytes)
+{
+    compactionThreshold = journalBytes;
+}
+
+size_t JournaledUserManager::getPendingBytes() const
+{
+    return pendingLength;
+}
+
+bool JournaledUserManager::hasFailed() const
+{
+    return failed;
+}
+
+size_t JournaledUserManager::getRecordSize(const User* user)
+{
+    size_t size = RecordHeaderSize + CrcSize;
+    if(user)
+        size += user->getUsername().length() + user->getPassword().length() + user->getName().length() + 3;
+
+    return size;
+}
+
+size_t JournaledUserManager::encodeRecord(RecordKind kind, User::IdType id, const User* user, std::span<uint8_t> bytes)
+{
+    size_t size = getRecordSize(user);
+
+    writeLittleEndian(bytes.subspan(0, 2), size - 2 - CrcSize);
+    bytes[2] = std::to_underlying(kind);
+    writeLittleEndian(bytes.subspan(3, 2), id);
+    bytes[5] = std::to_underlying(user ? user->getPermission() : Permission::None);
+
+    size_t offset = RecordHeaderSize;
+    if(user)
+    {
+        for(std::string_view string : {user->getUsername(), user->getPassword(), user->getName()})
+        {
+            std::copy(string.begin(), string.end(), bytes.begin() + offset);
+            offset += string.length();
+            bytes[offset++] = '\0';
+        }
+    }
+
+    writeLittleEndian(bytes.subspan(offset, CrcSize), Crc32::compute(bytes.first(offset)));
+    return size;
+}
+
+ResultVoid JournaledUserManager::applyRecord(std::span<const uint8_t> record)
+{
+    auto kind = static_cast<RecordKind>(record[2]);
+    User::IdType id = readLittleEndian(record.subspan(3, 2));
+    uint8_t permission = record[5];
+
+    if(kind == RecordKind::Delete)
+    {
+        // Deleting a user that's already gone leaves the same users behind.
+        auto deleted = deleteUser(id);
+        if(!deleted && deleted.error() != AuthenticationError::UserIdNotFound)
+            return Error(deleted.error());
+        return {};
+    }
+
+    if(kind != RecordKind::Create && kind != RecordKind::Update)
+        return Error(AuthenticationError::IntegrityFailure);
+
+    if(permission > std::to_underlying(Permission::None))
+        return Error(AuthenticationError::IntegrityFailure);
+
+    std::array<std::string_view, 3> strings;
+    auto payload = record.subspan(RecordHeaderSize, record.size() - RecordHeaderSize - CrcSize);
+    for(std::string_view& string : strings)
+    {
+        auto terminator = std::find(payload.begin(), payload.end(), '\0');
+        if(terminator == payload.end())
+            return Error(AuthenticationError::IntegrityFailure);
+
+        size_t length = terminator - payload.begin();
+        string = std::string_view(reinterpret_cast<const char*>(payload.data()), length);
+        payload = payload.subspan(length + 1);
+    }
+
+    auto restored = restoreUser(id, static_cast<Permission>(permission), strings[0], strings[1], strings[2]);
+    if(!restored)
+        return Error(restored.error());
+
+    return {};
+}
+
+ResultVoid JournaledUserManager::appendRecord(RecordKind kind, User::IdType id, const User* user)
+{
+    size_t size = getRecordSize(user);
+    if(size > pending.size())
+        return Error(AuthenticationError::StorageFailure);
+
+    if(pendingLength + size > pending.size())
+    {
+        auto committed = commit();
+        if(!committed)
+            return Error(committed.error());
+    }
+
+    pendingLength += encodeRecord(kind, id, user, std::span(pending).subspan(pendingLength));
+    return {};
+}
+
+Result<uint32_t> JournaledUserManager::checkSnapshot(JournalStorage& storage)
+{
+    std::array<uint8_t, FooterSize> footer{};
+    if(storage.size() < FooterSize)
+        return Error(AuthenticationError::IntegrityFailure);
+
+    size_t recordsEnd = storage.size() - FooterSize;
+    auto footerRead = storage.read(recordsEnd, footer);
+    if(!footerRead)
+        return Error(footerRead.error());
+
+    auto footerBytes = std::span<const uint8_t>(footer);
+    bool complete =
+        *footerRead == footer.size() &&
+        std::equal(SnapshotMagic.begin(), SnapshotMagic.end(), footer.begin()) &&
+        readLittleEndian(footerBytes.subspan(8, 4)) == recordsEnd;
+
+    if(!complete)
+        return Error(AuthenticationError::IntegrityFailure);
+
+    // The pending buffer isn't in use yet, it's reused to read the records.
+    uint32_t crc = Crc32::Initial;
+    for(size_t offset = 0; offset < recordsEnd;)
+    {
+        auto chunk = std::span(pending).first(std::min(pending.size(), recordsEnd - offset));
+        auto chunkRead = storage.read(offset, chunk);
+        if(!chunkRead)
+            return Error(chunkRead.error());
+        if(*chunkRead != chunk.size())
+            return Error(AuthenticationError::IntegrityFailure);
+
+        crc = Crc32::compute(chunk, crc);
+        offset += chunk.size();
+    }
+
+    if(crc != readLittleEndian(footerBytes.subspan(12, 4)))
+        return Error(AuthenticationError::IntegrityFailure);
+
+    return readLittleEndian(footerBytes.subspan(4, 4));
+}
+
+Result<size_t> JournaledUserManager::replay(JournalStorage& storage, size_t begin, size_t end)
+{
+    size_t offset = begin;
+    while(end - offset >= RecordHeaderSize + CrcSize)
+    {
+        std::array<uint8_t, 2> sizeBytes;
+        auto sizeRead = storage.read(offset, sizeBytes);
+        if(!sizeRead)
+            return Error(sizeRead.error());
+
+        size_t size = 2 + readLittleEndian(sizeBytes) + CrcSize;
+        if(size < RecordHeaderSize + CrcSize || size > pending.size() || size > end - offset)
+            break;
+
+        auto record = std::span(pending).first(size);
+        auto recordRead = storage.read(offset, record);
+        if(!recordRead)
+            return Error(recordRead.error());
+
+        auto crcBytes = std::span<const uint8_t>(record).last(CrcSize);
+        if(*recordRead != size || Crc32::compute(record.first(size - CrcSize)) != readLittleEndian(crcBytes))
+            break;
+
+        auto applied = applyRecord(record);
+        if(!applied)
+            return Error(applied.error());
+
+        offset += size;
+    }
+
+    return offset;
+}
+
+ResultVoid JournaledUserManager::resetJournal()
+{
+    std::array<uint8_t, JournalHeaderSize> header{};
+    std::copy(JournalMagic.begin(), JournalMagic.end(), header.begin());
+    writeLittleEndian(std::span(header).subspan(4), generation);
+
+    auto truncated = journal->truncate(0);
+    if(!truncated)
+        return Error(truncated.error());
+
+    auto appended = journal->append(header);
+    if(!appended)
+        return Error(appended.error());
+
+    return journal->sync();
+}
+
+void JournaledUserManager::userChanged(size_t slot, Mutation mutation, User::IdType id)
+{
+    if(!journal || replaying)
+        return;
+
+    ResultVoid appended;
+    switch(mutation)
+    {
+        case Mutation::Created:
+            appended = appendRecord(RecordKind::Create, id, users[slot]);
+            break;
+        case Mutation::Updated:
+            appended = appendRecord(RecordKind::Update, id, users[slot]);
+            break;
+        case Mutation::Deleted:
+            appended = appendRecord(RecordKind::Delete, id, nullptr);
+            break;
+        default:
+            // Reserved slots hold no user yet.
+            break;
+    }
+
+    if(!appended)
+        failed = true;
+}
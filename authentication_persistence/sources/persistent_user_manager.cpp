@@ -0,0 +1,299 @@
+#include "persistent_user_manager.hpp"
+
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static constexpr size_t SlotAlignment = 8;
+
+PersistentUser::PersistentUser()
+    : User({}, {}, {})
+{}
+
+ResultVoid PersistentUser::reserve()
+{
+    if(!isMapped())
+        return Error(AuthenticationError::StorageFailure);
+
+    return User::reserve();
+}
+
+bool PersistentUser::isMapped() const
+{
+    return !username.empty();
+}
+
+ResultVoid PersistentUser::prepareString(StringField field, size_t length)
+{
+    if(!isMapped())
+        return Error(AuthenticationError::StorageFailure);
+
+    return User::prepareString(field, length);
+}
+
+ResultVoid PersistentUser::checkStrings(const UserPatch& patch) const
+{
+    if(!isMapped())
+        return Error(AuthenticationError::StorageFailure);
+
+    return User::checkStrings(patch);
+}
+
+void PersistentUser::releaseStrings()
+{
+    if(isMapped())
+        User::releaseStrings();
+}
+
+PersistentUserManager::PersistentUserManager(std::span<User*> usersStorage, std::span<User::IdType> idsStorage, std::span<Permission> permissionsStorage,
+                                             std::span<SlotState> statesStorage, std::span<uint32_t> usernameHashesStorage,
+                                             size_t usernameSize, size_t passwordSize, size_t nameSize)
+    : UserManager(usersStorage, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage),
+      usernameSize(usernameSize), passwordSize(passwordSize), nameSize(nameSize)
+{
+    size_t size = sizeof(SlotHeader) + usernameSize + passwordSize + nameSize;
+    slotSize = (size + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+}
+
+PersistentUserManager::~PersistentUserManager()
+{
+    // The users may already be destroyed, only the mapping is released.
+    unmap();
+}
+
+ResultVoid PersistentUserManager::open(const char* path)
+{
+    close();
+
+    size_t fileSize = HeaderSize + users.size() * slotSize;
+
+    int newFd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(newFd < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    struct stat status;
+    if(fstat(newFd, &status) < 0)
+    {
+        ::close(newFd);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    bool created = status.st_size == 0;
+    if(!created && static_cast<size_t>(status.st_size) != fileSize)
+    {
+        ::close(newFd);
+        return Error(AuthenticationError::IntegrityFailure);
+    }
+
+    if(created && ftruncate(newFd, fileSize) < 0)
+    {
+        ::close(newFd);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    void* address = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, newFd, 0);
+    if(address == MAP_FAILED)
+    {
+        ::close(newFd);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    fd = newFd;
+    mapping = std::span(static_cast<char*>(address), fileSize);
+    failed = false;
+
+    FileHeader expected = makeHeader();
+    if(created)
+    {
+        std::memcpy(mapping.data(), &expected, sizeof(expected));
+        auto synced = sync(mapping.first(HeaderSize));
+        if(!synced)
+        {
+            close();
+            return Error(synced.error());
+        }
+    }
+    else
+    {
+        FileHeader header;
+        std::memcpy(&header, mapping.data(), sizeof(header));
+
+        bool matches =
+            header.magic == expected.magic &&
+            header.version == expected.version &&
+            header.slotsAmount == expected.slotsAmount &&
+            header.slotSize == expected.slotSize &&
+            header.usernameSize == expected.usernameSize &&
+            header.passwordSize == expected.passwordSize &&
+            header.nameSize == expected.nameSize;
+
+        if(!matches)
+        {
+            close();
+            return Error(AuthenticationError::IntegrityFailure);
+        }
+    }
+
+    loadedUsers = 0;
+    idCounter = 0;
+    for(size_t slot = 0; slot < users.size(); slot++)
+    {
+        auto loaded = loadSlot(slot);
+        if(!loaded)
+        {
+            close();
+            return Error(loaded.error());
+        }
+    }
+
+    return {};
+}
+
+void PersistentUserManager::close()
+{
+    if(mapping.empty())
+        return;
+
+    // The users can't point to the mapping once it's gone.
+    for(size_t slot = 0; slot < users.size(); slot++)
+    {
+        auto user = static_cast<PersistentUser*>(users[slot]);
+        user->username = {};
+        user->password = {};
+        user->name = {};
+        user->usernameLength = 0;
+        user->passwordLength = 0;
+        user->nameLength = 0;
+        user->valid = false;
+        user->reserved = false;
+        mirrorSlot(slot);
+    }
+
+    unmap();
+}
+
+void PersistentUserManager::unmap()
+{
+    if(mapping.empty())
+        return;
+
+    munmap(mapping.data(), mapping.size());
+    ::close(fd);
+    mapping = {};
+    fd = -1;
+}
+
+bool PersistentUserManager::hasFailed() const
+{
+    return failed;
+}
+
+PersistentUserManager::FileHeader PersistentUserManager::makeHeader() const
+{
+    FileHeader header{};
+    header.magic = Magic;
+    header.version = Version;
+    header.slotsAmount = users.size();
+    header.slotSize = slotSize;
+    header.usernameSize = usernameSize;
+    header.passwordSize = passwordSize;
+    header.nameSize = nameSize;
+    return header;
+}
+
+std::span<char> PersistentUserManager::getSlot(size_t slot)
+{
+    return mapping.subspan(HeaderSize + slot * slotSize, slotSize);
+}
+
+ResultVoid PersistentUserManager::loadSlot(size_t slot)
+{
+    auto user = static_cast<PersistentUser*>(users[slot]);
+    auto bytes = getSlot(slot);
+
+    SlotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    auto strings = bytes.subspan(sizeof(SlotHeader));
+    user->username = strings.subspan(0, usernameSize);
+    user->password = strings.subspan(usernameSize, passwordSize);
+    user->name = strings.subspan(usernameSize + passwordSize, nameSize);
+
+    user->id = 0;
+    user->permission = Permission::None;
+    user->usernameLength = 0;
+    user->passwordLength = 0;
+    user->nameLength = 0;
+    user->valid = false;
+    user->reserved = false;
+
+    if(header.state == std::to_underlying(SlotState::Valid))
+    {
+        bool consistent =
+            header.permission <= std::to_underlying(Permission::None) &&
+            header.usernameLength < usernameSize &&
+            header.passwordLength < passwordSize &&
+            header.nameLength < nameSize;
+
+        if(!consistent)
+            return Error(AuthenticationError::IntegrityFailure);
+
+        user->id = header.id;
+        user->permission = static_cast<Permission>(header.permission);
+        user->usernameLength = header.usernameLength;
+        user->passwordLength = header.passwordLength;
+        user->nameLength = header.nameLength;
+        user->valid = true;
+
+        loadedUsers++;
+        idCounter = std::max<User::IdType>(idCounter, header.id + 1);
+    }
+
+    mirrorSlot(slot);
+    return {};
+}
+
+void PersistentUserManager::storeSlot(size_t slot)
+{
+    const User* user = users[slot];
+
+    SlotHeader header{};
+    header.state = std::to_underlying(user->isValid() ? SlotState::Valid : SlotState::Free);
+    header.permission = std::to_underlying(user->getPermission());
+    header.id = user->getId();
+    header.usernameLength = user->getUsername().length();
+    header.passwordLength = user->getPassword().length();
+    header.nameLength = user->getName().length();
+
+    std::memcpy(getSlot(slot).data(), &header, sizeof(header));
+}
+
+ResultVoid PersistentUserManager::sync(std::span<char> bytes)
+{
+    // msync needs an address aligned to a page, the mapping itself is.
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    size_t start = (bytes.data() - mapping.data()) / pageSize * pageSize;
+    size_t end = bytes.data() - mapping.data() + bytes.size();
+
+    if(msync(mapping.data() + start, end - start, MS_SYNC) < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    return {};
+}
+
+void PersistentUserManager::userChanged(size_t slot, Mutation mutation, User::IdType)
+{
+    // A reserved slot is still free in the file until the user is created.
+    if(mapping.empty() || mutation == Mutation::Reserved)
+        return;
+
+    storeSlot(slot);
+    if(!sync(getSlot(slot)))
+        failed = true;
+}
@@ -0,0 +1,219 @@
+#include "session_snapshot.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <climits>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "crc.hpp"
+#include "little_endian.hpp"
+
+static uint32_t getUsernameCrc(const User& user)
+{
+    std::string_view username = user.getUsername();
+    return Crc32::compute(std::span(reinterpret_cast<const uint8_t*>(username.data()), username.size()));
+}
+
+static ResultVoid writeAll(int fd, std::span<const uint8_t> bytes, size_t offset)
+{
+    size_t done = 0;
+    while(done < bytes.size())
+    {
+        ssize_t written = pwrite(fd, bytes.data() + done, bytes.size() - done, offset + done);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written < 0)
+            return Error(AuthenticationError::StorageFailure);
+        done += written;
+    }
+
+    return {};
+}
+
+static Result<size_t> readAll(int fd, std::span<uint8_t> bytes, size_t offset)
+{
+    size_t done = 0;
+    while(done < bytes.size())
+    {
+        ssize_t received = pread(fd, bytes.data() + done, bytes.size() - done, offset + done);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received < 0)
+            return Error(AuthenticationError::StorageFailure);
+        if(received == 0)
+            break;
+        done += received;
+    }
+
+    return done;
+}
+
+ResultVoid SessionSnapshot::save(const SessionManager& sessionManager, const char* path)
+{
+    // The file is replaced by a rename, a crash while writing leaves the previous one.
+    char temporaryPath[PATH_MAX];
+    int length = std::snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+    if(length < 0 || static_cast<size_t>(length) >= sizeof(temporaryPath))
+        return Error(AuthenticationError::StorageFailure);
+
+    int fd = ::open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    std::array<uint8_t, RecordSize * BufferedRecords> buffer;
+    size_t buffered = 0;
+    size_t offset = HeaderSize;
+    uint32_t amount = 0;
+    uint32_t crc = Crc32::Initial;
+    ResultVoid written;
+
+    auto flush = [&]() {
+        auto bytes = std::span<const uint8_t>(buffer).first(buffered);
+        crc = Crc32::compute(bytes, crc);
+        written = writeAll(fd, bytes, offset);
+        offset += buffered;
+        buffered = 0;
+    };
+
+    for(const Session* session : sessionManager.getSessions())
+    {
+        const User* user = session->getUser();
+        if(session->isExpired() || !user->isValid())
+            continue;
+
+        auto record = std::span(buffer).subspan(buffered, RecordSize);
+        writeLittleEndian(record.subspan(0, 8), session->getToken());
+        writeLittleEndian(record.subspan(8, 4), session->getExpireTime());
+        writeLittleEndian(record.subspan(12, 2), user->getId());
+        writeLittleEndian(record.subspan(14, 4), getUsernameCrc(*user));
+        buffered += RecordSize;
+        amount++;
+
+        if(buffered == buffer.size())
+            flush();
+        if(!written)
+            break;
+    }
+
+    if(written && buffered > 0)
+        flush();
+
+    if(written)
+    {
+        std::array<uint8_t, HeaderSize> header{};
+        std::copy(Magic.begin(), Magic.end(), header.begin());
+        writeLittleEndian(std::span(header).subspan(4, 4), Version);
+        writeLittleEndian(std::span(header).subspan(8, 4), amount);
+        writeLittleEndian(std::span(header).subspan(12, 4), crc);
+        written = writeAll(fd, header, 0);
+    }
+
+    if(written && fdatasync(fd) < 0)
+        written = Error(AuthenticationError::StorageFailure);
+
+    ::close(fd);
+
+    if(written && std::rename(temporaryPath, path) < 0)
+        written = Error(AuthenticationError::StorageFailure);
+
+    if(!written)
+        ::unlink(temporaryPath);
+
+    return written;
+}
+
+Result<size_t> SessionSnapshot::restore(SessionManager& sessionManager, const UserManager& userManager, const char* path)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0 && errno == ENOENT)
+        return 0;
+    if(fd < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    std::array<uint8_t, HeaderSize> header;
+    std::array<uint8_t, RecordSize * BufferedRecords> buffer;
+
+    auto readRecords = [&](auto function) -> ResultVoid {
+        size_t amount = readLittleEndian(std::span(header).subspan(8, 4));
+        size_t offset = HeaderSize;
+        while(amount > 0)
+        {
+            size_t chunkRecords = std::min(amount, BufferedRecords);
+            auto chunk = std::span(buffer).first(chunkRecords * RecordSize);
+            auto chunkRead = readAll(fd, chunk, offset);
+            if(!chunkRead)
+                return Error(chunkRead.error());
+            if(*chunkRead != chunk.size())
+                return Error(AuthenticationError::IntegrityFailure);
+
+            auto processed = function(chunk);
+            if(!processed)
+                return processed;
+
+            offset += chunk.size();
+            amount -= chunkRecords;
+        }
+
+        return {};
+    };
+
+    auto headerRead = readAll(fd, header, 0);
+    ResultVoid checked;
+    if(!headerRead)
+        checked = Error(headerRead.error());
+    else if(*headerRead != header.size() ||
+            !std::equal(Magic.begin(), Magic.end(), header.begin()) ||
+            readLittleEndian(std::span(header).subspan(4, 4)) != Version)
+        checked = Error(AuthenticationError::IntegrityFailure);
+
+    // Nothing is restored from a file that doesn't match its checksum.
+    uint32_t crc = Crc32::Initial;
+    if(checked)
+    {
+        checked = readRecords([&](std::span<const uint8_t> chunk) -> ResultVoid {
+            crc = Crc32::compute(chunk, crc);
+            return {};
+        });
+    }
+
+    if(checked && crc != readLittleEndian(std::span(header).subspan(12, 4)))
+        checked = Error(AuthenticationError::IntegrityFailure);
+
+    size_t restored = 0;
+    if(checked)
+    {
+        checked = readRecords([&](std::span<const uint8_t> chunk) -> ResultVoid {
+            for(size_t offset = 0; offset < chunk.size(); offset += RecordSize)
+            {
+                auto record = chunk.subspan(offset, RecordSize);
+                Session::TokenType token = readLittleEndian(record.subspan(0, 8));
+                uint32_t expireTime = readLittleEndian(record.subspan(8, 4));
+                User::IdType id = readLittleEndian(record.subspan(12, 2));
+                uint32_t usernameCrc = readLittleEndian(record.subspan(14, 4));
+
+                // The user was deleted or replaced since the sessions were saved.
+                auto user = userManager.getUser(id);
+                if(!user || getUsernameCrc(**user) != usernameCrc)
+                    continue;
+
+                auto session = sessionManager.restoreSession(**user, token, expireTime);
+                if(!session && session.error() != AuthenticationError::InvalidToken)
+                    return Error(session.error());
+                if(session)
+                    restored++;
+            }
+
+            return {};
+        });
+    }
+
+    ::close(fd);
+
+    if(!checked)
+        return Error(checked.error());
+
+    return restored;
+}
@@ -0,0 +1,218 @@
+#include "shared_session_manager.hpp"
+
+#include <new>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+size_t SharedSessionTable::getSegmentSize(size_t capacity)
+{
+    return EntriesOffset + capacity * sizeof(Entry);
+}
+
+SharedSessionManager::SharedSessionManager(std::span<Session*> sessionsStorage, const Clock& clock, const UserManager& userManager)
+    : SessionManager(sessionsStorage, clock), userManager(&userManager)
+{}
+
+SharedSessionManager::~SharedSessionManager()
+{
+    close();
+}
+
+ResultVoid SharedSessionManager::open(const char* name)
+{
+    close();
+
+    size_t nameLength = std::strlen(name);
+    if(nameLength >= segmentName.size())
+        return Error(AuthenticationError::StorageFailure);
+
+    // Readers still mapping a previous segment keep it until they reopen.
+    shm_unlink(name);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if(fd < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    size_t size = getSegmentSize(sessions.size());
+    if(ftruncate(fd, size) < 0)
+    {
+        ::close(fd);
+        shm_unlink(name);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(address == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    std::memcpy(segmentName.data(), name, nameLength + 1);
+    mapping = std::span(static_cast<std::byte*>(address), size);
+
+    auto header = new (mapping.data()) Header{};
+    header->version = Version;
+    header->capacity = sessions.size();
+
+    auto firstEntry = reinterpret_cast<Entry*>(mapping.data() + EntriesOffset);
+    for(size_t index = 0; index < sessions.size(); index++)
+        new (firstEntry + index) Entry{};
+    entries = std::span(firstEntry, sessions.size());
+
+    for(size_t index = 0; index < entries.size(); index++)
+        publish(index);
+
+    header->magic.store(Magic, std::memory_order_release);
+    return {};
+}
+
+void SharedSessionManager::close()
+{
+    if(mapping.empty())
+        return;
+
+    munmap(mapping.data(), mapping.size());
+    shm_unlink(segmentName.data());
+    mapping = {};
+    entries = {};
+}
+
+void SharedSessionManager::publish(size_t index)
+{
+    const Session* session = sessions[index];
+    Entry& entry = entries[index];
+
+    uint64_t token = 0;
+    uint32_t expireTime = 0;
+    uint32_t userSlot = 0;
+    User::IdType userId = 0;
+    if(!session->isExpired())
+    {
+        auto slot = userManager->getSlot(*session->getUser());
+        if(slot)
+        {
+            token = session->getToken();
+            expireTime = session->getExpireTime();
+            userSlot = *slot;
+            userId = session->getUser()->getId();
+        }
+    }
+
+    uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+    entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    entry.token.store(token, std::memory_order_relaxed);
+    entry.expireTime.store(expireTime, std::memory_order_relaxed);
+    entry.userSlot.store(userSlot, std::memory_order_relaxed);
+    entry.userId.store(userId, std::memory_order_relaxed);
+
+    entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SharedSessionManager::sessionChanged(size_t index)
+{
+    if(!mapping.empty())
+        publish(index);
+}
+
+SharedSessionReader::SharedSessionReader(const Clock& clock)
+    : clock(&clock)
+{}
+
+SharedSessionReader::~SharedSessionReader()
+{
+    close();
+}
+
+ResultVoid SharedSessionReader::open(const char* name)
+{
+    close();
+
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if(fd < 0)
+        return Error(AuthenticationError::StorageFailure);
+
+    struct stat status;
+    if(fstat(fd, &status) < 0 || static_cast<size_t>(status.st_size) < EntriesOffset)
+    {
+        ::close(fd);
+        return Error(AuthenticationError::StorageFailure);
+    }
+
+    size_t size = status.st_size;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(address == MAP_FAILED)
+        return Error(AuthenticationError::StorageFailure);
+
+    mapping = std::span(static_cast<const std::byte*>(address), size);
+
+    auto header = reinterpret_cast<const Header*>(mapping.data());
+    bool matches =
+        header->magic.load(std::memory_order_acquire) == Magic &&
+        header->version == Version &&
+        getSegmentSize(header->capacity) == size;
+
+    if(!matches)
+    {
+        close();
+        return Error(AuthenticationError::IntegrityFailure);
+    }
+
+    entries = std::span(reinterpret_cast<const Entry*>(mapping.data() + EntriesOffset), header->capacity);
+    return {};
+}
+
+void SharedSessionReader::close()
+{
+    if(mapping.empty())
+        return;
+
+    munmap(const_cast<std::byte*>(mapping.data()), mapping.size());
+    mapping = {};
+    entries = {};
+}
+
+Result<SharedSession> SharedSessionReader::validate(Session::TokenType token) const
+{
+    if(!token)
+        return Error(AuthenticationError::InvalidToken);
+
+    uint32_t time = clock->getTime();
+    for(const Entry& entry : entries)
+    {
+        // Cheap filter, the entry is read again consistently if it may match.
+        if(entry.token.load(std::memory_order_relaxed) != token)
+            continue;
+
+        for(size_t attempt = 0; attempt < ReadAttempts; attempt++)
+        {
+            uint32_t sequence = entry.sequence.load(std::memory_order_acquire);
+            if(sequence & 1)
+                continue;
+
+            SharedSession session;
+            session.token = entry.token.load(std::memory_order_relaxed);
+            session.expireTime = entry.expireTime.load(std::memory_order_relaxed);
+            session.userSlot = entry.userSlot.load(std::memory_order_relaxed);
+            session.userId = entry.userId.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(entry.sequence.load(std::memory_order_relaxed) != sequence)
+                continue;
+
+            if(session.token == token && time < session.expireTime)
+                return session;
+            break;
+        }
+    }
+
+    return Error(AuthenticationError::InvalidToken);
+}
@@ -0,0 +1,517 @@
+#include "user_transfer.hpp"
+
+#include <charconv>
+#include <utility>
+#include <algorithm>
+
+#include "crc.hpp"
+#include "little_endian.hpp"
+#include "user_patch.hpp"
+
+static constexpr std::string_view CsvHeader = "id,permission,username,name,password\n";
+
+// Appends to the storage through a fixed buffer, keeping the first error.
+class UserTransfer::Writer
+{
+    public:
+        Writer(JournalStorage& storage) : storage(storage) {}
+
+        void write(std::span<const uint8_t> bytes)
+        {
+            while(!bytes.empty() && status)
+            {
+                size_t amount = std::min(bytes.size(), buffer.size() - buffered);
+                std::copy_n(bytes.begin(), amount, buffer.begin() + buffered);
+                buffered += amount;
+                bytes = bytes.subspan(amount);
+
+                if(buffered == buffer.size())
+                    flush();
+            }
+        }
+
+        void write(std::string_view text)
+        {
+            write(std::span(reinterpret_cast<const uint8_t*>(text.data()), text.size()));
+        }
+
+        ResultVoid finish()
+        {
+            flush();
+            return status;
+        }
+
+    protected:
+        JournalStorage& storage;
+        std::array<uint8_t, BufferSize> buffer;
+        size_t buffered = 0;
+        ResultVoid status;
+
+        void flush()
+        {
+            if(status && buffered > 0)
+                status = storage.append(std::span<const uint8_t>(buffer).first(buffered));
+            buffered = 0;
+        }
+};
+
+// Reads the storage from the start through a fixed buffer.
+class UserTransfer::Reader
+{
+    public:
+        static constexpr int End = -1;
+
+        Reader(JournalStorage& storage) : storage(storage) {}
+
+        // Next byte, or End past the last one.
+        Result<int> get()
+        {
+            if(position == filled)
+            {
+                auto refilled = refill();
+                if(!refilled)
+                    return Error(refilled.error());
+                if(filled == 0)
+                    return End;
+            }
+
+            return buffer[position++];
+        }
+
+        // Returns the amount of bytes read, less than requested at the end.
+        Result<size_t> read(std::span<uint8_t> bytes)
+        {
+            size_t done = 0;
+            while(done < bytes.size())
+            {
+                if(position == filled)
+                {
+                    auto refilled = refill();
+                    if(!refilled)
+                        return Error(refilled.error());
+                    if(filled == 0)
+                        break;
+                }
+
+                size_t amount = std::min(bytes.size() - done, filled - position);
+                std::copy_n(buffer.begin() + position, amount, bytes.begin() + done);
+                position += amount;
+                done += amount;
+            }
+
+            return done;
+        }
+
+    protected:
+        JournalStorage& storage;
+        std::array<uint8_t, BufferSize> buffer;
+        size_t offset = 0;
+        size_t position = 0;
+        size_t filled = 0;
+
+        ResultVoid refill()
+        {
+            auto received = storage.read(offset, buffer);
+            if(!received)
+                return Error(received.error());
+
+            offset += *received;
+            position = 0;
+            filled = *received;
+            return {};
+        }
+};
+
+ResultVoid UserTransfer::exportUsers(const UserManager& userManager, JournalStorage& storage, Format format)
+{
+    Writer writer(storage);
+
+    if(format == Format::Csv)
+        writer.write(CsvHeader);
+    else
+    {
+        std::array<uint8_t, BinaryHeaderSize> header{};
+        std::copy(Magic.begin(), Magic.end(), header.begin());
+        writeLittleEndian(std::span(header).subspan(4, 4), Version);
+        writer.write(header);
+    }
+
+    for(size_t slot = 0; slot < userManager.getMaxUsers(); slot++)
+    {
+        auto user = userManager.getUserInSlot(slot);
+        if(!user)
+            continue;
+
+        if(format == Format::Csv)
+            writeCsv(writer, **user);
+        else
+            writeBinary(writer, **user);
+    }
+
+    return writer.finish();
+}
+
+Result<UserTransfer::ImportSummary> UserTransfer::importUsers(UserManager& userManager, JournalStorage& storage, Format format, std::string_view defaultPassword)
+{
+    Reader reader(storage);
+    Record record;
+
+    if(format == Format::Csv)
+    {
+        // The header is only checked to have the fields of the format.
+        auto read = readCsvFields(reader, {}, {});
+        if(!read)
+            return Error(read.error());
+        if(!*read)
+            return ImportSummary{};
+    }
+    else
+    {
+        std::array<uint8_t, BinaryHeaderSize> header;
+        auto read = reader.read(header);
+        if(!read)
+            return Error(read.error());
+        if(*read != header.size() ||
+           !std::equal(Magic.begin(), Magic.end(), header.begin()) ||
+           readLittleEndian(std::span(header).subspan(4, 4)) != Version)
+            return Error(AuthenticationError::IntegrityFailure);
+    }
+
+    ImportSummary summary;
+    while(true)
+    {
+        auto read = format == Format::Csv ? readCsv(reader, record) : readBinary(reader, record);
+        if(!read)
+            return Error(read.error());
+        if(!*read)
+            break;
+
+        // An exported user imported back keeps its password, the export doesn't have it.
+        // A user of another device with the same id is a different user, it must not get that password.
+        auto existing = userManager.getUser(record.id);
+        if(record.password.empty() && existing && (*existing)->getUsername() == record.username)
+        {
+            UserPatch patch{.name = record.name, .permission = record.permission};
+            auto patched = userManager.patchUser(record.id, patch);
+            if(!patched)
+                return Error(patched.error());
+
+            summary.imported++;
+            continue;
+        }
+
+        std::string_view password = record.password.empty() ? defaultPassword : record.password;
+        auto user = userManager.restoreUser(record.id, record.permission, record.username, password, record.name);
+        if(!user)
+            return Error(user.error());
+
+        summary.imported++;
+        if(record.password.empty())
+            summary.defaultPasswords++;
+    }
+
+    return summary;
+}
+
+void UserTransfer::writeCsv(Writer& writer, const User& user)
+{
+    std::array<char, 8> id;
+    auto converted = std::to_chars(id.data(), id.data() + id.size(), user.getId());
+
+    writer.write(std::string_view(id.data(), converted.ptr));
+    writer.write(",");
+    writer.write(getPermissionName(user.getPermission()));
+    writer.write(",");
+    writeCsvField(writer, user.getUsername());
+    writer.write(",");
+    writeCsvField(writer, user.getName());
+    // The password is never exported.
+    writer.write(",\n");
+}
+
+void UserTransfer::writeCsvField(Writer& writer, std::string_view field)
+{
+    if(field.find_first_of(",\"\r\n") == std::string_view::npos)
+    {
+        writer.write(field);
+        return;
+    }
+
+    writer.write("\"");
+    size_t quote;
+    while((quote = field.find('"')) != std::string_view::npos)
+    {
+        writer.write(field.substr(0, quote + 1));
+        writer.write("\"");
+        field = field.substr(quote + 1);
+    }
+    writer.write(field);
+    writer.write("\"");
+}
+
+void UserTransfer::writeBinary(Writer& writer, const User& user)
+{
+    std::string_view username = user.getUsername();
+    std::string_view name = user.getName();
+
+    // The password length is always 0, the password is never exported.
+    std::array<uint8_t, RecordHeaderSize> header{};
+    writeLittleEndian(std::span(header).subspan(0, 2), user.getId());
+    writeLittleEndian(std::span(header).subspan(2, 1), std::to_underlying(user.getPermission()));
+    writeLittleEndian(std::span(header).subspan(3, 2), username.size());
+    writeLittleEndian(std::span(header).subspan(5, 2), name.size());
+
+    auto usernameBytes = std::span(reinterpret_cast<const uint8_t*>(username.data()), username.size());
+    auto nameBytes = std::span(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+
+    std::array<uint8_t, 4> crc;
+    uint32_t value = Crc32::compute(header);
+    value = Crc32::compute(usernameBytes, value);
+    value = Crc32::compute(nameBytes, value);
+    writeLittleEndian(crc, value);
+
+    writer.write(header);
+    writer.write(usernameBytes);
+    writer.write(nameBytes);
+    writer.write(crc);
+}
+
+Result<bool> UserTransfer::readCsv(Reader& reader, Record& record)
+{
+    std::array<char, 8> id;
+    std::array<char, 16> permission;
+    std::array<std::span<char>, CsvFields> fields{id, permission, record.usernameBuffer, record.nameBuffer, record.passwordBuffer};
+    std::array<size_t, CsvFields> lengths;
+
+    auto read = readCsvFields(reader, fields, lengths);
+    if(!read || !*read)
+        return read;
+
+    unsigned int idValue;
+    auto parsed = std::from_chars(id.data(), id.data() + lengths[0], idValue);
+    if(lengths[0] == 0 || parsed.ec != std::errc() || parsed.ptr != id.data() + lengths[0] || idValue > UINT16_MAX)
+        return Error(AuthenticationError::IntegrityFailure);
+
+    auto parsedPermission = parsePermission(std::string_view(permission.data(), lengths[1]));
+    if(!parsedPermission)
+        return Error(parsedPermission.error());
+
+    record.id = idValue;
+    record.permission = *parsedPermission;
+    record.username = std::string_view(record.usernameBuffer.data(), lengths[2]);
+    record.name = std::string_view(record.nameBuffer.data(), lengths[3]);
+    record.password = std::string_view(record.passwordBuffer.data(), lengths[4]);
+    return true;
+}
+
+Result<bool> UserTransfer::readCsvFields(Reader& reader, std::span<const std::span<char>> fields, std::span<size_t> lengths)
+{
+    // Without fields the line is only checked to be the header.
+    size_t headerPosition = 0;
+    bool header = fields.empty();
+
+    size_t field = 0;
+    size_t length = 0;
+    bool quoted = false;
+    bool quoteClosed = false;
+    // Nothing was read in the line, or in the current field.
+    bool empty = true;
+    bool fieldEmpty = true;
+
+    auto store = [&](char character) -> ResultVoid {
+        empty = false;
+        fieldEmpty = false;
+        if(header)
+        {
+            if(headerPosition >= CsvHeader.size() || CsvHeader[headerPosition++] != character)
+                return Error(AuthenticationError::IntegrityFailure);
+            return {};
+        }
+
+        if(length >= fields[field].size())
+            return Error(AuthenticationError::Overflow);
+        fields[field][length++] = character;
+        return {};
+    };
+
+    while(true)
+    {
+        auto next = reader.get();
+        if(!next)
+            return Error(next.error());
+        int character = *next;
+
+        if(quoted && !quoteClosed)
+        {
+            if(character == Reader::End)
+                return Error(AuthenticationError::IntegrityFailure);
+
+            if(character == '"')
+                quoteClosed = true;
+            else
+            {
+                auto stored = store(character);
+                if(!stored)
+                    return Error(stored.error());
+            }
+            continue;
+        }
+
+        // Two quotes in a quoted field are a quote of the value.
+        if(quoted && character == '"')
+        {
+            quoteClosed = false;
+            auto stored = store('"');
+            if(!stored)
+                return Error(stored.error());
+            continue;
+        }
+
+        if(character == '"' && fieldEmpty)
+        {
+            quoted = true;
+            fieldEmpty = false;
+            empty = false;
+            continue;
+        }
+
+        if(character == '\r')
+        {
+            auto newline = reader.get();
+            if(!newline)
+                return Error(newline.error());
+            if(*newline != '\n')
+                return Error(AuthenticationError::IntegrityFailure);
+            character = '\n';
+        }
+
+        // Blank lines between records are skipped.
+        if((character == '\n' || character == Reader::End) && empty && field == 0)
+        {
+            if(character == Reader::End)
+                return false;
+            continue;
+        }
+
+        if(character == ',' || character == '\n' || character == Reader::End)
+        {
+            bool last = character != ',';
+            if(header)
+            {
+                auto stored = store(last ? '\n' : ',');
+                if(!stored)
+                    return Error(stored.error());
+            }
+            else
+                lengths[field] = length;
+
+            field++;
+            length = 0;
+            fieldEmpty = true;
+            quoted = false;
+            quoteClosed = false;
+
+            if(last)
+            {
+                if(field != CsvFields || (header && headerPosition != CsvHeader.size()))
+                    return Error(AuthenticationError::IntegrityFailure);
+                return true;
+            }
+
+            if(field == CsvFields)
+                return Error(AuthenticationError::IntegrityFailure);
+            continue;
+        }
+
+        // Anything else after the closing quote, or a quote inside an unquoted field.
+        if(quoted || character == '"')
+            return Error(AuthenticationError::IntegrityFailure);
+
+        auto stored = store(character);
+        if(!stored)
+            return Error(stored.error());
+    }
+}
+
+Result<bool> UserTransfer::readBinary(Reader& reader, Record& record)
+{
+    std::array<uint8_t, RecordHeaderSize> header;
+    auto read = reader.read(header);
+    if(!read)
+        return Error(read.error());
+    if(*read == 0)
+        return false;
+    if(*read != header.size())
+        return Error(AuthenticationError::IntegrityFailure);
+
+    uint8_t permission = readLittleEndian(std::span(header).subspan(2, 1));
+    size_t usernameLength = readLittleEndian(std::span(header).subspan(3, 2));
+    size_t nameLength = readLittleEndian(std::span(header).subspan(5, 2));
+    size_t passwordLength = readLittleEndian(std::span(header).subspan(7, 2));
+
+    if(permission > std::to_underlying(Permission::None))
+        return Error(AuthenticationError::IntegrityFailure);
+    if(usernameLength > MaxStringSize || nameLength > MaxStringSize || passwordLength > MaxStringSize)
+        return Error(AuthenticationError::Overflow);
+
+    uint32_t crc = Crc32::compute(header);
+    auto readString = [&](std::array<char, MaxStringSize>& buffer, size_t length) -> Result<std::string_view> {
+        auto bytes = std::span(reinterpret_cast<uint8_t*>(buffer.data()), length);
+        auto stringRead = reader.read(bytes);
+        if(!stringRead)
+            return Error(stringRead.error());
+        if(*stringRead != length)
+            return Error(AuthenticationError::IntegrityFailure);
+
+        crc = Crc32::compute(bytes, crc);
+        return std::string_view(buffer.data(), length);
+    };
+
+    auto username = readString(record.usernameBuffer, usernameLength);
+    if(!username)
+        return Error(username.error());
+    auto name = readString(record.nameBuffer, nameLength);
+    if(!name)
+        return Error(name.error());
+    auto password = readString(record.passwordBuffer, passwordLength);
+    if(!password)
+        return Error(password.error());
+
+    std::array<uint8_t, 4> storedCrc;
+    auto crcRead = reader.read(storedCrc);
+    if(!crcRead)
+        return Error(crcRead.error());
+    if(*crcRead != storedCrc.size() || readLittleEndian(storedCrc) != crc)
+        return Error(AuthenticationError::IntegrityFailure);
+
+    record.id = readLittleEndian(std::span(header).subspan(0, 2));
+    record.permission = static_cast<Permission>(permission);
+    record.username = *username;
+    record.name = *name;
+    record.password = *password;
+    return true;
+}
+
+std::string_view UserTransfer::getPermissionName(Permission permission)
+{
+    switch(permission)
+    {
+        case Permission::Superuser:
+            return "Superuser";
+        case Permission::Maintenance:
+            return "Maintenance";
+        case Permission::Observer:
+            return "Observer";
+        default:
+            return "None";
+    }
+}
+
+Result<Permission> UserTransfer::parsePermission(std::string_view name)
+{
+    for(Permission permission : {Permission::Superuser, Permission::Maintenance, Permission::Observer, Permission::None})
+        if(getPermissionName(permission) == name)
+            return permission;
+
+    return Error(AuthenticationError::IntegrityFailure);
+}
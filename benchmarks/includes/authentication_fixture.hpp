@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "authentication.hpp"
+
+// User and session tables sized at run time. The first filledUsers slots hold
+// users that are logged in, the first one is a superuser. The tables of the
+// largest sizes take seconds to fill, so a fixture is kept between the runs of
+// the same arguments: see getFixture.
+class AuthenticationFixture
+{
+    public:
+        static constexpr size_t UsernameLength = 16;
+        static constexpr size_t PasswordLength = 16;
+        static constexpr size_t NameLength = 16;
+
+        static constexpr std::string_view Password = "password";
+
+        AuthenticationFixture(size_t tableSize, size_t filledUsers);
+
+        AuthenticationFixture(const AuthenticationFixture&) = delete;
+        AuthenticationFixture& operator=(const AuthenticationFixture&) = delete;
+
+        Authentication& getAuthentication();
+        UserManager& getUserManager();
+        SessionManager& getSessionManager();
+
+        size_t getTableSize() const;
+        size_t getFilledUsers() const;
+
+        std::string_view getUsername(size_t index) const;
+        // Tokens must be updated when a benchmark logs the user in again.
+        Session::TokenType getToken(size_t index) const;
+        void setToken(size_t index, Session::TokenType token);
+
+    protected:
+        using UserType = StaticUser<UsernameLength, PasswordLength, NameLength>;
+
+        size_t tableSize;
+
+        std::vector<UserType> usersStorage;
+        std::vector<User*> usersPointers;
+        std::vector<User::IdType> idsStorage;
+        std::vector<Permission> permissionsStorage;
+        std::vector<UserManager::SlotState> statesStorage;
+        std::vector<uint32_t> usernameHashesStorage;
+        std::vector<Session> sessionsStorage;
+        std::vector<Session*> sessionsPointers;
+
+        Clock clock;
+        UserManager userManager;
+        SessionManager sessionManager;
+        Authentication authentication;
+
+        std::vector<std::string> usernames;
+        std::vector<Session::TokenType> tokens;
+};
+
+// Fixture for the arguments table size and fill percentage, reused while they don't change.
+AuthenticationFixture& getFixture(size_t tableSize, size_t fillPercentage);
+// Makes the next getFixture build a new fixture, for benchmarks that change the tables for good.
+void discardFixture();
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <span>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+#include <initializer_list>
+
+// Minimal harness in the style of Google Benchmark, so the suite has no
+// dependency to fetch. A benchmark is a function that prepares its fixture,
+// then runs the measured code while keepRunning() returns true:
+//
+//     static void benchmarkSomething(BenchmarkState& state)
+//     {
+//         Fixture fixture(state.getArgument(0));
+//         while(state.keepRunning())
+//             fixture.something();
+//     }
+//     BENCHMARK(benchmarkSomething)->setArguments({8, 64});
+//
+// Every registered set of arguments is run with growing iteration counts until
+// the measurement takes long enough, then the time and the heap allocations
+// per iteration are printed. With --check-allocations the executable fails if
+// any measured code allocated, which guards the allocation-free hot paths.
+class BenchmarkState
+{
+    public:
+        BenchmarkState(size_t iterations, std::span<const int64_t> arguments);
+
+        bool keepRunning();
+
+        // Excludes the code between both calls from the measurement, for example to undo what an iteration did.
+        void pauseTiming();
+        void resumeTiming();
+
+        int64_t getArgument(size_t index) const;
+
+        std::chrono::nanoseconds getElapsed() const;
+        size_t getIterations() const;
+        size_t getAllocations() const;
+
+    protected:
+        using Clock = std::chrono::steady_clock;
+
+        size_t iterations;
+        size_t iterationsLeft;
+        std::span<const int64_t> arguments;
+
+        bool started = false;
+        bool running = false;
+        Clock::time_point startTime;
+        std::chrono::nanoseconds elapsed{0};
+        size_t startAllocations = 0;
+        size_t allocations = 0;
+
+        void start();
+        void stop();
+};
+
+using BenchmarkFunction = void (*)(BenchmarkState& state);
+
+class Benchmark
+{
+    public:
+        Benchmark(const char* name, BenchmarkFunction function);
+
+        // Adds a run with these arguments, every call adds one.
+        Benchmark* setArguments(std::initializer_list<int64_t> arguments);
+        // Adds a run for every combination of the values of each argument.
+        Benchmark* setArgumentsProduct(std::initializer_list<std::initializer_list<int64_t>> values);
+
+        // Returns false if any measured iteration allocated from the heap.
+        bool run(const char* filter) const;
+
+    protected:
+        const char* name;
+        BenchmarkFunction function;
+        std::vector<std::vector<int64_t>> argumentSets;
+};
+
+// Keeps the compiler from optimizing away a result that is never used.
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+Benchmark* registerBenchmark(const char* name, BenchmarkFunction function);
+
+// Amount of heap allocations made by the process so far.
+size_t getAllocationCount();
+
+#define BENCHMARK_CONCATENATE_(a, b) a##b
+#define BENCHMARK_CONCATENATE(a, b) BENCHMARK_CONCATENATE_(a, b)
+#define BENCHMARK(function) \
+    [[maybe_unused]] static Benchmark* BENCHMARK_CONCATENATE(benchmark_, __LINE__) = registerBenchmark(#function, function)
@@ -0,0 +1,210 @@
+#include "benchmark.hpp"
+#include "authentication_fixture.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+// Arguments of every benchmark: table size, then the percentage of it filled with logged in users.
+static constexpr std::initializer_list<int64_t> TableSizes = {8, 64, 512, 4096, 65535};
+static constexpr std::initializer_list<int64_t> FillPercentages = {10, 50, 100};
+
+static AuthenticationFixture& getFixture(const BenchmarkState& state)
+{
+    return getFixture(state.getArgument(0), state.getArgument(1));
+}
+
+static void benchmarkValidate(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        doNotOptimize(authentication.validate(fixture.getToken(index)));
+        if(++index == fixture.getFilledUsers())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkValidate)->setArgumentsProduct({TableSizes, FillPercentages});
+
+static void benchmarkValidateWithPermission(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        doNotOptimize(authentication.validateWithPermission(fixture.getToken(index), Permission::Observer));
+        if(++index == fixture.getFilledUsers())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkValidateWithPermission)->setArgumentsProduct({TableSizes, FillPercentages});
+
+static void benchmarkAuthenticate(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        auto session = authentication.authenticate(fixture.getUsername(index), AuthenticationFixture::Password);
+        if(!session)
+            std::abort();
+
+        // The previous session of the user was replaced.
+        fixture.setToken(index, (*session)->getToken());
+        if(++index == fixture.getFilledUsers())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkAuthenticate)->setArgumentsProduct({TableSizes, FillPercentages});
+
+static void benchmarkCreateUser(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+    auto& userManager = fixture.getUserManager();
+
+    // A full table has no slot to create a user in, the last user leaves it for the run.
+    size_t last = fixture.getFilledUsers() - 1;
+    bool full = fixture.getFilledUsers() == fixture.getTableSize();
+    if(full && !userManager.deleteUser(fixture.getUsername(last)))
+        std::abort();
+
+    while(state.keepRunning())
+    {
+        auto id = authentication.createUser(fixture.getToken(0), Permission::Observer, "benchmark", AuthenticationFixture::Password, "");
+        if(!id)
+            std::abort();
+
+        // Ids wrap around after enough iterations, the username stays unique.
+        state.pauseTiming();
+        if(!userManager.deleteUser("benchmark"))
+            std::abort();
+        state.resumeTiming();
+    }
+
+    if(full)
+    {
+        auto user = userManager.createUser(Permission::Observer, fixture.getUsername(last), AuthenticationFixture::Password);
+        auto session = authentication.authenticate(fixture.getUsername(last), AuthenticationFixture::Password);
+        if(!user || !session)
+            std::abort();
+
+        fixture.setToken(last, (*session)->getToken());
+    }
+}
+BENCHMARK(benchmarkCreateUser)->setArgumentsProduct({TableSizes, FillPercentages});
+
+// One iteration creates a whole batch, up to 256 users or the free slots.
+static void benchmarkCreateUsers(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+    auto& userManager = fixture.getUserManager();
+
+    size_t batchSize = std::min<size_t>(fixture.getTableSize() - fixture.getFilledUsers(), 256);
+    std::vector<std::string> usernames;
+    for(size_t index = 0; index < batchSize; index++)
+        usernames.push_back("batch" + std::to_string(index));
+
+    std::vector<UserSpec> specs;
+    for(const std::string& username : usernames)
+        specs.push_back(UserSpec{Permission::Observer, username, AuthenticationFixture::Password, ""});
+
+    std::vector<ResultUser> results(batchSize);
+    while(state.keepRunning())
+    {
+        auto created = authentication.createUsers(fixture.getToken(0), specs, results);
+        if(!created || *created != batchSize)
+            std::abort();
+
+        state.pauseTiming();
+        for(const std::string& username : usernames)
+        {
+            if(!userManager.deleteUser(username))
+                std::abort();
+        }
+        state.resumeTiming();
+    }
+}
+// Full tables have no room for a batch.
+BENCHMARK(benchmarkCreateUsers)->setArgumentsProduct({TableSizes, {10, 50}});
+
+static void benchmarkLogOut(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        if(!authentication.logOut(fixture.getToken(index)))
+            std::abort();
+
+        state.pauseTiming();
+        auto session = authentication.authenticate(fixture.getUsername(index), AuthenticationFixture::Password);
+        if(!session)
+            std::abort();
+        fixture.setToken(index, (*session)->getToken());
+        state.resumeTiming();
+
+        if(++index == fixture.getFilledUsers())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkLogOut)->setArgumentsProduct({TableSizes, FillPercentages});
+
+static void benchmarkModifyName(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+    auto& userManager = fixture.getUserManager();
+
+    std::vector<User::IdType> ids;
+    for(size_t index = 0; index < fixture.getFilledUsers(); index++)
+        ids.push_back((*userManager.getUser(fixture.getUsername(index)))->getId());
+
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        if(!authentication.modifyName(fixture.getToken(0), ids[index], index & 1 ? "odd" : "even"))
+            std::abort();
+        if(++index == ids.size())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkModifyName)->setArgumentsProduct({TableSizes, FillPercentages});
+
+static void benchmarkModifyOwnPassword(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state);
+    auto& authentication = fixture.getAuthentication();
+
+    // The password is set to itself, so the fixture stays valid.
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        if(!authentication.modifyOwnPassword(fixture.getToken(index), AuthenticationFixture::Password, AuthenticationFixture::Password))
+            std::abort();
+        if(++index == fixture.getFilledUsers())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkModifyOwnPassword)->setArgumentsProduct({TableSizes, FillPercentages});
+
+static void benchmarkUpdateSessions(BenchmarkState& state)
+{
+    auto& authentication = getFixture(state).getAuthentication();
+
+    while(state.keepRunning())
+        authentication.updateSessions();
+}
+BENCHMARK(benchmarkUpdateSessions)->setArgumentsProduct({TableSizes, FillPercentages});
@@ -0,0 +1,107 @@
+#include "authentication_fixture.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+
+template <typename Base, typename T>
+static std::vector<Base*> getPointers(std::vector<T>& storage)
+{
+    std::vector<Base*> pointers;
+    for(T& element : storage)
+        pointers.push_back(&element);
+
+    return pointers;
+}
+
+AuthenticationFixture::AuthenticationFixture(size_t tableSize, size_t filledUsers)
+    : tableSize(tableSize),
+      usersStorage(tableSize), usersPointers(getPointers<User>(usersStorage)),
+      idsStorage(tableSize), permissionsStorage(tableSize), statesStorage(tableSize), usernameHashesStorage(tableSize),
+      sessionsStorage(tableSize), sessionsPointers(getPointers<Session>(sessionsStorage)),
+      userManager(usersPointers, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage),
+      sessionManager(sessionsPointers, clock),
+      authentication(userManager, sessionManager)
+{
+    for(size_t index = 0; index < filledUsers; index++)
+    {
+        char username[UsernameLength];
+        std::snprintf(username, sizeof(username), "user%05u", static_cast<unsigned>(index));
+        usernames.emplace_back(username);
+
+        Permission permission = index == 0 ? Permission::Superuser : Permission::Observer;
+        auto user = userManager.createUser(permission, usernames.back(), Password);
+        auto session = authentication.authenticate(usernames.back(), Password);
+        if(!user || !session)
+        {
+            std::fprintf(stderr, "Could not fill the tables of size %zu.\n", tableSize);
+            std::exit(EXIT_FAILURE);
+        }
+
+        tokens.push_back((*session)->getToken());
+    }
+}
+
+Authentication& AuthenticationFixture::getAuthentication()
+{
+    return authentication;
+}
+
+UserManager& AuthenticationFixture::getUserManager()
+{
+    return userManager;
+}
+
+SessionManager& AuthenticationFixture::getSessionManager()
+{
+    return sessionManager;
+}
+
+size_t AuthenticationFixture::getTableSize() const
+{
+    return tableSize;
+}
+
+size_t AuthenticationFixture::getFilledUsers() const
+{
+    return usernames.size();
+}
+
+std::string_view AuthenticationFixture::getUsername(size_t index) const
+{
+    return usernames[index];
+}
+
+Session::TokenType AuthenticationFixture::getToken(size_t index) const
+{
+    return tokens[index];
+}
+
+void AuthenticationFixture::setToken(size_t index, Session::TokenType token)
+{
+    tokens[index] = token;
+}
+
+static std::unique_ptr<AuthenticationFixture> fixture;
+static size_t fixtureFillPercentage = 0;
+
+AuthenticationFixture& getFixture(size_t tableSize, size_t fillPercentage)
+{
+    if(!fixture || fixture->getTableSize() != tableSize || fixtureFillPercentage != fillPercentage)
+    {
+        // The superuser is always there, so every fixture can create users.
+        size_t filledUsers = std::max<size_t>(tableSize * fillPercentage / 100, 1);
+
+        fixture.reset();
+        fixture = std::make_unique<AuthenticationFixture>(tableSize, filledUsers);
+        fixtureFillPercentage = fillPercentage;
+    }
+
+    return *fixture;
+}
+
+void discardFixture()
+{
+    fixture.reset();
+}
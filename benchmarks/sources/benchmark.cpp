@@ -0,0 +1,247 @@
+#include "benchmark.hpp"
+
+#include <new>
+#include <deque>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+// Every measurement runs at least this long, unless it reached MaxIterations.
+static constexpr std::chrono::milliseconds MinTime{200};
+static constexpr size_t MaxIterations = 1'000'000'000;
+
+static size_t allocationCount = 0;
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    if(void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+
+    // The libraries may be built without exceptions.
+    std::abort();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+size_t getAllocationCount()
+{
+    return allocationCount;
+}
+
+BenchmarkState::BenchmarkState(size_t iterations, std::span<const int64_t> arguments)
+    : iterations(iterations), iterationsLeft(iterations), arguments(arguments)
+{}
+
+bool BenchmarkState::keepRunning()
+{
+    if(!started)
+    {
+        started = true;
+        start();
+    }
+
+    if(iterationsLeft > 0)
+    {
+        iterationsLeft--;
+        return true;
+    }
+
+    stop();
+    return false;
+}
+
+void BenchmarkState::pauseTiming()
+{
+    stop();
+}
+
+void BenchmarkState::resumeTiming()
+{
+    start();
+}
+
+int64_t BenchmarkState::getArgument(size_t index) const
+{
+    return index < arguments.size() ? arguments[index] : 0;
+}
+
+std::chrono::nanoseconds BenchmarkState::getElapsed() const
+{
+    return elapsed;
+}
+
+size_t BenchmarkState::getIterations() const
+{
+    return iterations;
+}
+
+size_t BenchmarkState::getAllocations() const
+{
+    return allocations;
+}
+
+void BenchmarkState::start()
+{
+    if(running)
+        return;
+
+    running = true;
+    startAllocations = getAllocationCount();
+    startTime = Clock::now();
+}
+
+void BenchmarkState::stop()
+{
+    if(!running)
+        return;
+
+    elapsed += Clock::now() - startTime;
+    allocations += getAllocationCount() - startAllocations;
+    running = false;
+}
+
+Benchmark::Benchmark(const char* name, BenchmarkFunction function)
+    : name(name), function(function)
+{}
+
+Benchmark* Benchmark::setArguments(std::initializer_list<int64_t> arguments)
+{
+    argumentSets.emplace_back(arguments);
+    return this;
+}
+
+Benchmark* Benchmark::setArgumentsProduct(std::initializer_list<std::initializer_list<int64_t>> values)
+{
+    std::vector<std::vector<int64_t>> product{{}};
+    for(auto argumentValues : values)
+    {
+        std::vector<std::vector<int64_t>> extended;
+        for(const auto& arguments : product)
+        {
+            for(int64_t value : argumentValues)
+            {
+                extended.push_back(arguments);
+                extended.back().push_back(value);
+            }
+        }
+        product = std::move(extended);
+    }
+
+    argumentSets.insert(argumentSets.end(), product.begin(), product.end());
+    return this;
+}
+
+bool Benchmark::run(const char* filter) const
+{
+    bool allocationFree = true;
+    static const std::vector<std::vector<int64_t>> noArguments{{}};
+    const auto& sets = argumentSets.empty() ? noArguments : argumentSets;
+
+    for(const auto& arguments : sets)
+    {
+        char label[128];
+        int length = std::snprintf(label, sizeof(label), "%s", name);
+        for(int64_t argument : arguments)
+            length += std::snprintf(label + length, sizeof(label) - length, "/%lld", static_cast<long long>(argument));
+
+        if(filter && !std::strstr(label, filter))
+            continue;
+
+        // Grows the iterations until the measurement is long enough to trust.
+        size_t iterations = 1;
+        while(true)
+        {
+            BenchmarkState state(iterations, arguments);
+            function(state);
+
+            bool longEnough = state.getElapsed() >= MinTime || iterations >= MaxIterations;
+            if(longEnough)
+            {
+                double nanoseconds = static_cast<double>(state.getElapsed().count()) / iterations;
+                double allocations = static_cast<double>(state.getAllocations()) / iterations;
+                std::printf("%-56s %14.1f ns/op %10.2f allocs/op %12zu iterations\n", label, nanoseconds, allocations, iterations);
+                allocationFree = allocationFree && state.getAllocations() == 0;
+                break;
+            }
+
+            // Aims a bit past the minimum time, without growing more than tenfold at once.
+            double elapsed = std::max<double>(state.getElapsed().count(), 1.0);
+            double target = std::chrono::nanoseconds(MinTime).count() * 1.4 / elapsed * iterations;
+            iterations = std::min<size_t>(std::max<double>(target, iterations + 1), iterations * 10);
+        }
+    }
+
+    return allocationFree;
+}
+
+static std::deque<Benchmark>& getBenchmarks()
+{
+    static std::deque<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+Benchmark* registerBenchmark(const char* name, BenchmarkFunction function)
+{
+    return &getBenchmarks().emplace_back(name, function);
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = nullptr;
+    bool checkAllocations = false;
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if(std::strcmp(argv[i], "--check-allocations") == 0)
+            checkAllocations = true;
+        else
+        {
+            std::fprintf(stderr,
+                "Usage: %s [--filter TEXT] [--check-allocations]\n"
+                "  --filter             Only runs the benchmarks whose name and arguments contain TEXT.\n"
+                "  --check-allocations  Fails if any measured iteration allocated from the heap.\n",
+                argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::printf("%-56s %20s %20s %23s\n", "Benchmark", "Time", "Allocations", "Iterations");
+    bool allocationFree = true;
+    for(const Benchmark& benchmark : getBenchmarks())
+        allocationFree = benchmark.run(filter) && allocationFree;
+
+    if(checkAllocations && !allocationFree)
+    {
+        std::fprintf(stderr, "Some benchmarks allocated from the heap.\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
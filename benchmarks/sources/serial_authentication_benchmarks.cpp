@@ -0,0 +1,110 @@
+#include "benchmark.hpp"
+#include "authentication_fixture.hpp"
+
+#include "serial_authentication_builder.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+static constexpr std::initializer_list<int64_t> TableSizes = {8, 64, 512, 4096, 65535};
+static constexpr std::initializer_list<int64_t> FillPercentages = {10, 50, 100};
+
+// Buffers of a parser, sized for the strings of the fixture.
+struct SerialBuffers
+{
+    std::array<char, AuthenticationFixture::UsernameLength> username;
+    std::array<char, AuthenticationFixture::NameLength> name;
+    std::array<char, AuthenticationFixture::PasswordLength> password;
+    std::array<char, AuthenticationFixture::PasswordLength> password2;
+};
+
+static SerialAuthentication buildSerial(AuthenticationFixture& fixture, SerialBuffers& buffers)
+{
+    auto serial = SerialAuthentication::Builder()
+        .setAuthentication(fixture.getAuthentication())
+        .setUsernameBuffer(buffers.username)
+        .setNameBuffer(buffers.name)
+        .setPasswordBuffer(buffers.password)
+        .setPassword2Buffer(buffers.password2)
+        .build();
+
+    if(!serial)
+        std::abort();
+
+    return *serial;
+}
+
+// Whole log in over the byte stream: operation, username, password, then the token and error code read back.
+static void benchmarkSerialLogIn(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state.getArgument(0), state.getArgument(1));
+
+    SerialBuffers buffers;
+    auto serial = buildSerial(fixture, buffers);
+
+    // Requests are prepared for every user before the measurement.
+    constexpr size_t RequestSize = AuthenticationFixture::UsernameLength + AuthenticationFixture::PasswordLength;
+    std::vector<std::array<uint8_t, RequestSize>> requests(fixture.getFilledUsers());
+    for(size_t index = 0; index < requests.size(); index++)
+    {
+        std::string_view username = fixture.getUsername(index);
+        std::string_view password = AuthenticationFixture::Password;
+        std::memcpy(requests[index].data(), username.data(), username.size());
+        requests[index][username.size()] = '\0';
+        std::memcpy(requests[index].data() + username.size() + 1, password.data(), password.size());
+        requests[index][username.size() + 1 + password.size()] = '\0';
+    }
+
+    std::array<uint8_t, sizeof(Session::TokenType) + 1> response;
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        serial.setOperation(SerialAuthentication::Operation::LogIn);
+        serial.authenticateBytes(requests[index]);
+        if(serial.getNextBytes(response) != response.size() || response.back() != 0)
+            std::abort();
+
+        Session::TokenType token;
+        std::memcpy(&token, response.data(), sizeof(token));
+        fixture.setToken(index, token);
+        if(++index == requests.size())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkSerialLogIn)->setArgumentsProduct({TableSizes, FillPercentages});
+
+// Superuser renaming every user in turn: operation, token, user id and name, then the error code read back.
+static void benchmarkSerialModifyName(BenchmarkState& state)
+{
+    auto& fixture = getFixture(state.getArgument(0), state.getArgument(1));
+    auto& userManager = fixture.getUserManager();
+
+    SerialBuffers buffers;
+    auto serial = buildSerial(fixture, buffers);
+
+    constexpr size_t RequestSize = sizeof(Session::TokenType) + sizeof(User::IdType) + AuthenticationFixture::NameLength;
+    std::vector<std::array<uint8_t, RequestSize>> requests(fixture.getFilledUsers());
+    Session::TokenType token = fixture.getToken(0);
+    for(size_t index = 0; index < requests.size(); index++)
+    {
+        User::IdType id = (*userManager.getUser(fixture.getUsername(index)))->getId();
+        std::memcpy(requests[index].data(), &token, sizeof(token));
+        std::memcpy(requests[index].data() + sizeof(token), &id, sizeof(id));
+        std::memcpy(requests[index].data() + sizeof(token) + sizeof(id), "name", 5);
+    }
+
+    std::array<uint8_t, 1> response;
+    size_t index = 0;
+    while(state.keepRunning())
+    {
+        serial.setOperation(SerialAuthentication::Operation::ModifyName);
+        serial.authenticateBytes(requests[index]);
+        if(serial.getNextBytes(response) != response.size() || response.back() != 0)
+            std::abort();
+
+        if(++index == requests.size())
+            index = 0;
+    }
+}
+BENCHMARK(benchmarkSerialModifyName)->setArgumentsProduct({TableSizes, FillPercentages});
@@ -0,0 +1,323 @@
+#include "serial_authentication_static.hpp"
+#include "serial_authentication_coroutine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+// Drives the plain and the coroutine parsers with the same random operations
+// and request bytes, each against its own users and sessions, and checks them
+// against a model of the protocol and against each other: both must consume
+// exactly the modelled request, send the modelled amount of response bytes,
+// answer with the same error codes and leave the same users behind.
+//
+// Every command of the input is a control byte followed by the fields of the
+// request. The low nibble of the control byte is the operation, values past the
+// last operation are invalid ones. The high nibble, when it's a field index, makes
+// the master read the response before sending that field. Token fields start with
+// a selector byte, picking a token of an earlier login or 8 bytes of the input.
+
+using Operation = SerialAuthentication::Operation;
+
+enum class Field
+{
+    None,
+    Token,
+    String,
+    UserId,
+    Permission,
+};
+
+struct Layout
+{
+    std::array<Field, 4> request;
+    size_t responseSize;
+};
+
+// Reference model of the unframed protocol, kept apart from the parser tables.
+static constexpr std::array<Layout, SerialAuthentication::OperationsAmount> layouts
+{{
+    // Idle
+    {{}, 0},
+
+    // LogIn
+    {{Field::String, Field::String}, sizeof(Session::TokenType)},
+    // LogOut
+    {{Field::Token}, 0},
+    // CreateUser
+    {{Field::Token, Field::String, Field::String, Field::Permission}, sizeof(User::IdType)},
+    // DeleteUser
+    {{Field::Token, Field::UserId}, 0},
+
+    // ModifyOwnUsername
+    {{Field::Token, Field::String}, 0},
+    // ModifyOwnPassword
+    {{Field::Token, Field::String, Field::String}, 0},
+    // ModifyOwnName
+    {{Field::Token, Field::String}, 0},
+
+    // ModifyUsername
+    {{Field::Token, Field::UserId, Field::String}, 0},
+    // ModifyPassword
+    {{Field::Token, Field::UserId, Field::String}, 0},
+    // ModifyName
+    {{Field::Token, Field::UserId, Field::String}, 0},
+    // ModifyPermission
+    {{Field::Token, Field::UserId, Field::Permission}, 0},
+}};
+
+static constexpr size_t BuffersSize = 8;
+static constexpr size_t MaxResponseSize = sizeof(Session::TokenType) + 1;
+
+static void check(bool condition, const char* what)
+{
+    if(condition)
+        return;
+
+    std::fprintf(stderr, "%s\n", what);
+    std::abort();
+}
+
+// Users, sessions and one parser. The clock never moves, so sessions don't expire.
+template <typename Parser>
+struct World
+{
+    Clock clock;
+    StaticUserManager<6, BuffersSize, BuffersSize, BuffersSize> userManager;
+    StaticSessionManager<3> sessionManager{clock};
+    Authentication authentication{userManager, sessionManager};
+    Parser parser{authentication};
+
+    // Tokens of the successful logins, in the same order in both worlds.
+    std::vector<Session::TokenType> tokens;
+
+    World()
+    {
+        (void)userManager.createUser(Permission::Superuser, "root", "root");
+        auto session = authentication.authenticate("root", "root");
+        if(session)
+            tokens.push_back((*session)->getToken());
+    }
+};
+
+using PlainWorld = World<SerialAuthenticationStatic<BuffersSize>>;
+using CoroutineWorld = World<CoroutineSerialAuthenticationStatic<BuffersSize>>;
+
+class Input
+{
+    public:
+        Input(std::span<const uint8_t> data) : data(data) {}
+
+        bool empty() const
+        {
+            return data.empty();
+        }
+
+        uint8_t take()
+        {
+            uint8_t byte = data.front();
+            data = data.subspan(1);
+            return byte;
+        }
+
+        // Up to size bytes, fewer when the input ends.
+        std::span<const uint8_t> take(size_t size)
+        {
+            std::span<const uint8_t> bytes = data.first(std::min(size, data.size()));
+            data = data.subspan(bytes.size());
+            return bytes;
+        }
+
+        // A string up to and including its null character, without it when the input ends.
+        std::span<const uint8_t> takeString()
+        {
+            const void* end = std::memchr(data.data(), '\0', data.size());
+            size_t size = end ? static_cast<const uint8_t*>(end) - data.data() + 1 : data.size();
+            return take(size);
+        }
+
+    private:
+        std::span<const uint8_t> data;
+};
+
+static std::span<const uint8_t> getTokenBytes(const Session::TokenType& token)
+{
+    return std::span(reinterpret_cast<const uint8_t*>(&token), sizeof(token));
+}
+
+static void checkSameState(PlainWorld& plain, CoroutineWorld& coroutine)
+{
+    check(plain.parser.isReading() == coroutine.parser.isReading(), "the parsers disagree on reading");
+    check(plain.parser.isResponding() == coroutine.parser.isResponding(), "the parsers disagree on responding");
+}
+
+static void checkSameUsers(const UserManager& plain, const UserManager& coroutine)
+{
+    for(size_t slot = 0; slot < plain.getMaxUsers(); slot++)
+    {
+        auto plainUser = plain.getUserInSlot(slot);
+        auto coroutineUser = coroutine.getUserInSlot(slot);
+        check(plainUser.has_value() == coroutineUser.has_value(), "the parsers left different user slots");
+        if(!plainUser)
+            continue;
+
+        const User& a = **plainUser;
+        const User& b = **coroutineUser;
+        check(a.getId() == b.getId() && a.getPermission() == b.getPermission() && a.getUsername() == b.getUsername() &&
+              a.getPassword() == b.getPassword() && a.getName() == b.getName(), "the parsers left different users");
+    }
+}
+
+// Reads the whole response of both parsers and checks it against the model.
+static void readResponses(PlainWorld& plain, CoroutineWorld& coroutine, Operation operation, bool complete)
+{
+    std::array<uint8_t, MaxResponseSize + 1> plainResponse{}, coroutineResponse{};
+    size_t plainSize = plain.parser.getNextBytes(plainResponse);
+    size_t coroutineSize = coroutine.parser.getNextBytes(coroutineResponse);
+    check(plainSize == coroutineSize, "the parsers sent responses of different sizes");
+    checkSameState(plain, coroutine);
+
+    // Without an error an incomplete request has no response yet.
+    if(plainSize == 0)
+    {
+        check(!complete || operation == Operation::Idle, "a complete request wasn't answered");
+        return;
+    }
+
+    const Layout& layout = layouts[std::to_underlying(operation)];
+    check(plainSize == layout.responseSize + 1, "the response size doesn't match the model");
+    check(!plain.parser.isResponding(), "the parser kept responding after the error code");
+
+    uint8_t error = plainResponse[layout.responseSize];
+    check(error == coroutineResponse[layout.responseSize], "the parsers sent different error codes");
+    check(complete || error != 0, "an incomplete request succeeded");
+
+    auto plainField = std::span(plainResponse).first(layout.responseSize);
+    auto coroutineField = std::span(coroutineResponse).first(layout.responseSize);
+    if(error != 0)
+    {
+        check(std::all_of(plainField.begin(), plainField.end(), [](uint8_t byte) {return byte == 0;}) &&
+              std::all_of(coroutineField.begin(), coroutineField.end(), [](uint8_t byte) {return byte == 0;}),
+              "a failed response wasn't padded with zeros");
+        return;
+    }
+
+    // Tokens are random, the rest of the responses match.
+    if(operation != Operation::LogIn)
+    {
+        check(std::equal(plainField.begin(), plainField.end(), coroutineField.begin()), "the parsers sent different responses");
+        return;
+    }
+
+    Session::TokenType plainToken, coroutineToken;
+    std::memcpy(&plainToken, plainField.data(), sizeof(plainToken));
+    std::memcpy(&coroutineToken, coroutineField.data(), sizeof(coroutineToken));
+    plain.tokens.push_back(plainToken);
+    coroutine.tokens.push_back(coroutineToken);
+}
+
+static void runCommand(PlainWorld& plain, CoroutineWorld& coroutine, Input& input)
+{
+    uint8_t control = input.take();
+    Operation operation = static_cast<Operation>(control & 0x0F);
+    size_t earlyRead = control >> 4;
+
+    plain.parser.setOperation(operation);
+    coroutine.parser.setOperation(operation);
+    checkSameState(plain, coroutine);
+
+    // The base parser turns invalid operations into Idle.
+    if(std::to_underlying(operation) >= static_cast<int>(SerialAuthentication::OperationsAmount))
+        operation = Operation::Idle;
+
+    const Layout& layout = layouts[std::to_underlying(operation)];
+    check(plain.parser.isReading() == (layout.request[0] != Field::None), "reading doesn't match the model");
+
+    bool complete = true;
+    for(size_t index = 0; index < layout.request.size() && layout.request[index] != Field::None; index++)
+    {
+        if(index == earlyRead)
+        {
+            readResponses(plain, coroutine, operation, false);
+            if(!plain.parser.isReading())
+                break;
+        }
+
+        if(input.empty())
+        {
+            complete = false;
+            break;
+        }
+
+        std::span<const uint8_t> plainBytes, coroutineBytes;
+        switch(layout.request[index])
+        {
+            case Field::Token:
+            {
+                uint8_t selector = input.take();
+                if(selector < 0xC0 && !plain.tokens.empty())
+                {
+                    plainBytes = getTokenBytes(plain.tokens[selector % plain.tokens.size()]);
+                    coroutineBytes = getTokenBytes(coroutine.tokens[selector % coroutine.tokens.size()]);
+                }
+                else
+                    plainBytes = coroutineBytes = input.take(sizeof(Session::TokenType));
+
+                complete = plainBytes.size() == sizeof(Session::TokenType);
+                break;
+            }
+
+            case Field::String:
+                plainBytes = coroutineBytes = input.takeString();
+                complete = !plainBytes.empty() && plainBytes.back() == '\0';
+                break;
+
+            case Field::UserId:
+                plainBytes = coroutineBytes = input.take(sizeof(User::IdType));
+                complete = plainBytes.size() == sizeof(User::IdType);
+                break;
+
+            case Field::Permission:
+                plainBytes = coroutineBytes = input.take(sizeof(uint16_t));
+                complete = plainBytes.size() == sizeof(uint16_t);
+                break;
+
+            default:
+                break;
+        }
+
+        // Even after an error every field of the request is consumed.
+        check(plain.parser.authenticateBytes(plainBytes) == plainBytes.size(), "the plain parser didn't consume a field");
+        check(coroutine.parser.authenticateBytes(coroutineBytes) == coroutineBytes.size(), "the coroutine parser didn't consume a field");
+        checkSameState(plain, coroutine);
+
+        if(!complete)
+            break;
+    }
+
+    if(plain.parser.isReading() || plain.parser.isResponding())
+    {
+        check(plain.parser.isReading() == !complete, "the request didn't end where the model does");
+        readResponses(plain, coroutine, operation, complete);
+    }
+
+    checkSameUsers(plain.userManager, coroutine.userManager);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    PlainWorld plain;
+    CoroutineWorld coroutine;
+
+    Input input(std::span(data, size));
+    while(!input.empty())
+        runCommand(plain, coroutine, input);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <random>
+#include <utility>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "authentication.hpp"
+
+// Clock moved by hand, so hours of sessions pass in a few seconds.
+class ManualClock : public Clock
+{
+    public:
+        uint32_t getTime() const override;
+        void setTime(uint32_t newTime);
+
+    protected:
+        uint32_t time = 0;
+};
+
+// Replays a random mix of operations against an Authentication with simulated
+// time, measuring the latency of every call. Periodic login storms, where every
+// user logs in at once, reproduce the start of a shift.
+class LoadGenerator
+{
+    public:
+        enum class Operation
+        {
+            LogIn,
+            Validate,
+            Edit,
+            LogOut,
+            UpdateSessions,
+        };
+
+        static constexpr size_t OperationsAmount = std::to_underlying(Operation::UpdateSessions) + 1;
+        // Operations picked at random, the sessions are updated on a schedule instead.
+        static constexpr size_t MixedOperationsAmount = std::to_underlying(Operation::LogOut) + 1;
+
+        struct Configuration
+        {
+            size_t users = 1024;
+            size_t sessions = 1024;
+            size_t operations = 1'000'000;
+
+            // Relative weights of LogIn, Validate, Edit and LogOut.
+            std::array<uint32_t, MixedOperationsAmount> mix{10, 80, 2, 8};
+
+            // Simulated time between operations, and the intervals of the scheduled events.
+            uint32_t operationsPerSecond = 100;
+            uint32_t sessionValiditySeconds = 3600;
+            // Zero disables the sliding renewal.
+            uint32_t renewalIntervalSeconds = 0;
+            uint32_t updateIntervalSeconds = 60;
+            // Zero disables the storms.
+            uint32_t stormIntervalSeconds = 0;
+            uint32_t sampleIntervalSeconds = 600;
+
+            uint32_t seed = 1;
+        };
+
+        LoadGenerator(const Configuration& configuration);
+
+        LoadGenerator(const LoadGenerator&) = delete;
+        LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+        // Runs every operation, printing the occupancy of the tables at every sample and the latencies at the end.
+        void run();
+
+        static const char* getName(Operation operation);
+
+    protected:
+        using UserType = StaticUser<16, 16, 16>;
+
+        Configuration configuration;
+
+        std::vector<UserType> usersStorage;
+        std::vector<User*> usersPointers;
+        std::vector<User::IdType> idsStorage;
+        std::vector<Permission> permissionsStorage;
+        std::vector<UserManager::SlotState> statesStorage;
+        std::vector<uint32_t> usernameHashesStorage;
+        std::vector<Session> sessionsStorage;
+        std::vector<Session*> sessionsPointers;
+
+        ManualClock clock;
+        UserManager userManager;
+        SessionManager sessionManager;
+        Authentication authentication;
+
+        std::vector<std::string> usernames;
+        std::vector<User::IdType> ids;
+        // Last token each user got, zero once it logged out.
+        std::vector<Session::TokenType> tokens;
+
+        std::mt19937 random;
+
+        // Latencies in nanoseconds and failed calls, for each operation.
+        std::array<std::vector<uint32_t>, OperationsAmount> latencies;
+        std::array<size_t, OperationsAmount> failures{};
+
+        void logIn(size_t user);
+        void validate(size_t user);
+        void edit(size_t user);
+        void logOut(size_t user);
+        void updateSessions();
+
+        // Superuser token for the edits, logging the superuser in again if its session expired.
+        Session::TokenType getSuperuserToken();
+
+        template <typename Function>
+        void measure(Operation operation, Function function);
+
+        Operation pickOperation();
+        size_t countSessions() const;
+        void printSample() const;
+        void printLatencies();
+};
@@ -0,0 +1,252 @@
+#include "load_generator.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+uint32_t ManualClock::getTime() const
+{
+    return time;
+}
+
+void ManualClock::setTime(uint32_t newTime)
+{
+    time = newTime;
+}
+
+template <typename Base, typename T>
+static std::vector<Base*> getPointers(std::vector<T>& storage)
+{
+    std::vector<Base*> pointers;
+    for(T& element : storage)
+        pointers.push_back(&element);
+
+    return pointers;
+}
+
+static constexpr std::string_view Password = "password";
+
+LoadGenerator::LoadGenerator(const Configuration& configuration)
+    : configuration(configuration),
+      usersStorage(configuration.users), usersPointers(getPointers<User>(usersStorage)),
+      idsStorage(configuration.users), permissionsStorage(configuration.users), statesStorage(configuration.users),
+      usernameHashesStorage(configuration.users),
+      sessionsStorage(configuration.sessions), sessionsPointers(getPointers<Session>(sessionsStorage)),
+      userManager(usersPointers, idsStorage, permissionsStorage, statesStorage, usernameHashesStorage),
+      sessionManager(sessionsPointers, clock),
+      authentication(userManager, sessionManager),
+      random(configuration.seed)
+{
+    sessionManager.setSessionValiditySeconds(configuration.sessionValiditySeconds);
+    sessionManager.setRenewalIntervalSeconds(configuration.renewalIntervalSeconds);
+
+    // The first user is the superuser doing the edits.
+    for(size_t index = 0; index < configuration.users; index++)
+    {
+        char username[32];
+        std::snprintf(username, sizeof(username), "user%05zu", index);
+        usernames.emplace_back(username);
+
+        Permission permission = index == 0 ? Permission::Superuser : Permission::Observer;
+        auto user = userManager.createUser(permission, usernames.back(), Password);
+        if(!user)
+        {
+            std::fprintf(stderr, "Could not create %zu users.\n", configuration.users);
+            std::exit(EXIT_FAILURE);
+        }
+
+        ids.push_back((*user)->getId());
+    }
+
+    tokens.resize(configuration.users);
+
+    // Runs without storms never grow the samples.
+    for(auto& operationLatencies : latencies)
+        operationLatencies.reserve(configuration.operations + configuration.users);
+}
+
+void LoadGenerator::run()
+{
+    std::printf("%10s %10s %18s\n", "Time (s)", "Users", "Sessions");
+
+    uint32_t nextUpdate = configuration.updateIntervalSeconds;
+    uint32_t nextStorm = configuration.stormIntervalSeconds;
+    uint32_t nextSample = 0;
+
+    for(size_t operation = 0; operation < configuration.operations; operation++)
+    {
+        uint32_t time = operation / configuration.operationsPerSecond;
+        clock.setTime(time);
+
+        if(time >= nextSample)
+        {
+            printSample();
+            nextSample += configuration.sampleIntervalSeconds;
+        }
+
+        if(configuration.updateIntervalSeconds && time >= nextUpdate)
+        {
+            updateSessions();
+            nextUpdate += configuration.updateIntervalSeconds;
+        }
+
+        if(configuration.stormIntervalSeconds && time >= nextStorm)
+        {
+            for(size_t user = 0; user < configuration.users; user++)
+                logIn(user);
+            nextStorm += configuration.stormIntervalSeconds;
+        }
+
+        size_t user = std::uniform_int_distribution<size_t>(0, configuration.users - 1)(random);
+        switch(pickOperation())
+        {
+            case Operation::LogIn:
+                logIn(user);
+                break;
+            case Operation::Validate:
+                validate(user);
+                break;
+            case Operation::Edit:
+                edit(user);
+                break;
+            case Operation::LogOut:
+                logOut(user);
+                break;
+            default:
+                break;
+        }
+    }
+
+    printSample();
+    printLatencies();
+}
+
+const char* LoadGenerator::getName(Operation operation)
+{
+    switch(operation)
+    {
+        case Operation::LogIn: return "LogIn";
+        case Operation::Validate: return "Validate";
+        case Operation::Edit: return "Edit";
+        case Operation::LogOut: return "LogOut";
+        case Operation::UpdateSessions: return "UpdateSessions";
+        default: return "";
+    }
+}
+
+void LoadGenerator::logIn(size_t user)
+{
+    measure(Operation::LogIn, [&]() {
+        auto session = authentication.authenticate(usernames[user], Password);
+        if(session)
+            tokens[user] = (*session)->getToken();
+        return session.has_value();
+    });
+}
+
+void LoadGenerator::validate(size_t user)
+{
+    // Users that never logged in validate a token that can't exist.
+    measure(Operation::Validate, [&]() {
+        return authentication.validate(tokens[user]).has_value();
+    });
+}
+
+void LoadGenerator::edit(size_t user)
+{
+    Session::TokenType token = getSuperuserToken();
+
+    char name[16];
+    std::snprintf(name, sizeof(name), "edit%u", clock.getTime());
+    measure(Operation::Edit, [&]() {
+        return authentication.modifyName(token, ids[user], name).has_value();
+    });
+}
+
+void LoadGenerator::logOut(size_t user)
+{
+    measure(Operation::LogOut, [&]() {
+        bool loggedOut = authentication.logOut(tokens[user]).has_value();
+        tokens[user] = 0;
+        return loggedOut;
+    });
+}
+
+void LoadGenerator::updateSessions()
+{
+    measure(Operation::UpdateSessions, [&]() {
+        authentication.updateSessions();
+        return true;
+    });
+}
+
+Session::TokenType LoadGenerator::getSuperuserToken()
+{
+    if(!authentication.validate(tokens[0]))
+        logIn(0);
+
+    return tokens[0];
+}
+
+template <typename Function>
+void LoadGenerator::measure(Operation operation, Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    bool succeeded = function();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t index = std::to_underlying(operation);
+    latencies[index].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    if(!succeeded)
+        failures[index]++;
+}
+
+LoadGenerator::Operation LoadGenerator::pickOperation()
+{
+    uint32_t total = 0;
+    for(uint32_t weight : configuration.mix)
+        total += weight;
+
+    uint32_t pick = std::uniform_int_distribution<uint32_t>(0, total - 1)(random);
+    for(size_t index = 0; index < configuration.mix.size(); index++)
+    {
+        if(pick < configuration.mix[index])
+            return static_cast<Operation>(index);
+        pick -= configuration.mix[index];
+    }
+
+    return Operation::Validate;
+}
+
+size_t LoadGenerator::countSessions() const
+{
+    auto sessions = sessionManager.getSessions();
+    return std::count_if(sessions.begin(), sessions.end(), [](const Session* session) {return !session->isExpired();});
+}
+
+void LoadGenerator::printSample() const
+{
+    std::printf("%10u %10zu %10zu/%-7zu\n", clock.getTime(), configuration.users, countSessions(), configuration.sessions);
+}
+
+void LoadGenerator::printLatencies()
+{
+    std::printf("\n%-16s %10s %10s %12s %12s %12s %12s\n", "Operation", "Calls", "Failed", "p50 (ns)", "p99 (ns)", "p999 (ns)", "Max (ns)");
+
+    for(size_t index = 0; index < OperationsAmount; index++)
+    {
+        auto& samples = latencies[index];
+        if(samples.empty())
+            continue;
+
+        std::sort(samples.begin(), samples.end());
+        auto getPercentile = [&](double percentile) {
+            return samples[std::min<size_t>(samples.size() * percentile, samples.size() - 1)];
+        };
+
+        std::printf("%-16s %10zu %10zu %12u %12u %12u %12u\n",
+            getName(static_cast<Operation>(index)), samples.size(), failures[index],
+            getPercentile(0.5), getPercentile(0.99), getPercentile(0.999), samples.back());
+    }
+}
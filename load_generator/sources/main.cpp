@@ -0,0 +1,105 @@
+#include "load_generator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+static void printUsage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s [OPTION VALUE]...\n"
+        "  --users N            Users created, the first one is a superuser. 1024 by default.\n"
+        "  --sessions N         Size of the session table. 1024 by default.\n"
+        "  --operations N       Operations to run. 1000000 by default.\n"
+        "  --mix L:V:E:O        Weights of log ins, validations, admin edits and log outs. 10:80:2:8 by default.\n"
+        "  --rate N             Operations per simulated second. 100 by default.\n"
+        "  --validity S         Seconds a session lasts. 3600 by default.\n"
+        "  --renewal S          Minimum seconds between renewals of a validated session, 0 disables them. Disabled by default.\n"
+        "  --update-interval S  Seconds between session updates, 0 disables them. 60 by default.\n"
+        "  --storm-interval S   Seconds between storms where every user logs in, 0 disables them. Disabled by default.\n"
+        "  --sample-interval S  Seconds between samples of the table occupancy. 600 by default.\n"
+        "  --seed N             Seed of the random operations. 1 by default.\n",
+        program);
+}
+
+static bool parseNumber(const char* argument, unsigned long long maximum, unsigned long long& value)
+{
+    char* end;
+    value = std::strtoull(argument, &end, 10);
+    return *argument && !*end && value <= maximum;
+}
+
+static bool parseMix(const char* argument, LoadGenerator::Configuration& configuration)
+{
+    uint32_t total = 0;
+    for(size_t index = 0; index < configuration.mix.size(); index++)
+    {
+        char* end;
+        unsigned long weight = std::strtoul(argument, &end, 10);
+        bool last = index + 1 == configuration.mix.size();
+        if(end == argument || weight > UINT16_MAX || *end != (last ? '\0' : ':'))
+            return false;
+
+        configuration.mix[index] = weight;
+        total += weight;
+        argument = end + 1;
+    }
+
+    return total > 0;
+}
+
+int main(int argc, char** argv)
+{
+    LoadGenerator::Configuration configuration;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string_view option = argv[i];
+        if(i + 1 >= argc)
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        const char* argument = argv[++i];
+        unsigned long long value = 0;
+        bool valid = true;
+
+        if(option == "--mix")
+            valid = parseMix(argument, configuration);
+        else if(!parseNumber(argument, UINT32_MAX, value))
+            valid = false;
+        else if(option == "--users" && value > 0 && value <= UINT16_MAX)
+            configuration.users = value;
+        else if(option == "--sessions" && value > 0)
+            configuration.sessions = value;
+        else if(option == "--operations")
+            configuration.operations = value;
+        else if(option == "--rate" && value > 0)
+            configuration.operationsPerSecond = value;
+        else if(option == "--validity")
+            configuration.sessionValiditySeconds = value;
+        else if(option == "--renewal")
+            configuration.renewalIntervalSeconds = value;
+        else if(option == "--update-interval")
+            configuration.updateIntervalSeconds = value;
+        else if(option == "--storm-interval")
+            configuration.stormIntervalSeconds = value;
+        else if(option == "--sample-interval" && value > 0)
+            configuration.sampleIntervalSeconds = value;
+        else if(option == "--seed")
+            configuration.seed = value;
+        else
+            valid = false;
+
+        if(!valid)
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    LoadGenerator generator(configuration);
+    generator.run();
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <optional>
+#include <utility>
 
 #include "authentication.hpp"
 
@@ -29,33 +30,87 @@ class SerialAuthentication
             ModifyPermission,
         };
 
-        void setOperation(Operation newOperation);
+        static constexpr size_t OperationsAmount = std::to_underlying(Operation::ModifyPermission) + 1;
 
-        void authenticateNextByte(uint8_t byte);
-        uint8_t getNextByte();
+        // Virtual so the variants of the protocol are driven the same way through a SerialAuthentication reference.
+        virtual void setOperation(Operation newOperation);
+
+        virtual void authenticateNextByte(uint8_t byte);
+        virtual uint8_t getNextByte();
+
+        // Stream helpers: consume bytes until the request is complete, and produce
+        // bytes until the error code was sent. Both return the amount of bytes used.
+        size_t authenticateBytes(std::span<const uint8_t> bytes);
+        size_t getNextBytes(std::span<uint8_t> bytes);
+
+        // True while the request of the current operation is being received.
+        virtual bool isReading() const;
+        // True when the request is complete and the response wasn't fully sent.
+        virtual bool isResponding() const;
 
         SerialAuthentication(const Configuration& configuration);
+        SerialAuthentication(const SerialAuthentication&) = default;
+        virtual ~SerialAuthentication() = default;
+
+        // Error code for an operation code without a request, Idle or unknown, on transports
+        // where the master waits for an answer to every operation code.
+        static uint8_t getInvalidOperationCode();
+
+        // Failed logins are also counted for the channel, when the Authentication has a login throttle.
+        void setChannel(LoginThrottle::ChannelId newChannel);
+
+#ifdef AUTHENTICATION_METRICS
+        using Metrics = OperationMetrics<OperationsAmount>;
+
+        // Shared by every parser, a failed operation is one that sent an error code.
+        static Metrics& getMetrics();
+#endif
 
     protected:
-        enum class State
+        // Every request is a sequence of fields sent by the master, and every
+        // response is at most one field followed by the error code.
+        enum class Field : uint8_t
         {
             None,
-            ReadReady,
 
-            ReadingToken,
-            ReadingUser,
-            ReadingPassword,
-            ReadingPassword2,
-            ReadingName,
-            ReadingUserId,
-            ReadingPermission,
+            Token,
+            Username,
+            // Username that must not belong to any user yet.
+            NewUsername,
+            Password,
+            Password2,
+            Name,
+            // Id that must belong to an existing user.
+            UserId,
+            Permission,
+        };
 
-            SendingToken,
-            SendingId,
+        static constexpr size_t MaxRequestFields = 4;
 
-            SendingErrorCode,
+        struct OperationLayout
+        {
+            std::array<Field, MaxRequestFields> request;
+            Field response;
+
+            // Permission checked when the token is received. None only requires a valid token.
+            Permission permissionNeeded;
+
+            // The strings of the new user are written straight into a user slot, reserved
+            // when the token is accepted, instead of the buffers.
+            bool reservesUser;
 
-            Error,
+            // Called once every field of the request was received without errors.
+            void (SerialAuthentication::*execute)();
+        };
+
+        static const std::array<OperationLayout, OperationsAmount> operationLayouts;
+
+        enum class State
+        {
+            None,
+            Reading,
+            Sending,
+            SendingErrorCode,
         };
 
         enum class Error
@@ -76,18 +131,42 @@ class SerialAuthentication
             ByteReadNotExpected,
 
             InternalError,
+
+            // The channel couldn't get buffers from a shared pool to read the request.
+            BuffersUnavailable,
+
+            // Too many failed logins for the username or the channel.
+            Throttled,
+
+            // The operation code of a frame isn't an operation.
+            InvalidOperation,
+        };
+
+        // A string field being received: where it's written and where its length is kept.
+        struct StringField
+        {
+            std::span<char> buffer;
+            uint16_t* length;
+            Error overflowError;
         };
 
         Authentication* authentication = nullptr;
+        std::optional<LoginThrottle::ChannelId> channel;
         std::span<char> currentUsername;
         std::span<char> currentPassword;
         std::span<char> currentPassword2;
         std::span<char> currentName;
+        uint16_t currentUsernameLength = 0;
+        uint16_t currentPasswordLength = 0;
+        uint16_t currentPassword2Length = 0;
+        uint16_t currentNameLength = 0;
+        User* reservedUser = nullptr;
         Session::TokenType currentToken;
         User::IdType currentId;
         uint16_t currentPermissionId;
         Permission currentPermission;
         uint16_t currentByteIndex = 0;
+        uint8_t currentFieldIndex = 0;
 
         // This variable is used when there's an error
         // to set in a default manner when the error code should
@@ -97,70 +176,48 @@ class SerialAuthentication
         // should be the error code.
         uint16_t writesUntilErrorCode = 0;
 
-        const Session* currentSession;
-
         State state = State::None;
         Error error = Error::None;
         Operation operation = Operation::Idle;
 
-        // Return true if the buffer is full or the null character '\0' was received.
-        bool setUsernameByte(uint8_t byte);
-        bool setPasswordByte(uint8_t byte);
-        bool setPassword2Byte(uint8_t byte);
-        bool setNameByte(uint8_t byte);
-        bool setIdByte(uint8_t byte);
-        bool setPermissionByte(uint8_t byte);
-        bool setTokenByte(uint8_t byte);
-
-        bool getUsernameByte(uint8_t* byte);
-        bool getPasswordByte(uint8_t* byte);
-        bool getPassword2Byte(uint8_t* byte);
-        bool getNameByte(uint8_t* byte);
-        bool getIdByte(uint8_t* byte);
-        bool getPermissionByte(uint8_t* byte);
-        bool getTokenByte(uint8_t* byte);
-
-        void readingToken(uint8_t byte, State nextState, Permission permissionNeeded = Permission::None);
-        bool readingUser(uint8_t byte, State nextState);
-        bool readingPassword(uint8_t byte, State nextState);
-        bool readingPassword2(uint8_t byte, State nextState);
-        bool readingName(uint8_t byte, State nextState);
-        bool readingUserId(uint8_t byte, State nextState);
-        bool readingPermission(uint8_t byte, State nextState);
-
-        // Read operations
-        void logIn(uint8_t byte);
-        void logOut(uint8_t byte);
-        void createUser(uint8_t byte);
-        void deleteUser(uint8_t byte);
-
-        void modifyOwnUsername(uint8_t byte);
-        void modifyOwnPassword(uint8_t byte);
-        void modifyOwnName(uint8_t byte);
-
-        void modifyUsername(uint8_t byte);
-        void modifyPassword(uint8_t byte);
-        void modifyName(uint8_t byte);
-        void modifyPermission(uint8_t byte);
-
-        // Write operations
-        uint8_t logIn();
-        uint8_t logOut();
-        uint8_t createUser();
-        uint8_t deleteUser();
-
-        uint8_t modifyOwnUsername();
-        uint8_t modifyOwnPassword();
-        uint8_t modifyOwnName();
-
-        uint8_t modifyUsername();
-        uint8_t modifyPassword();
-        uint8_t modifyName();
-        uint8_t modifyPermission();
-
-        uint8_t getNextTokenByte();
-
-        // Write states
-        uint8_t sendingToken();
-};
+        const OperationLayout& getLayout() const;
 
+        // Return true once the field is complete. String fields are complete when
+        // the null character '\0' is received, even if the buffer overflowed.
+        bool setFieldByte(Field field, uint8_t byte);
+        bool setStringByte(const StringField& string, uint8_t byte);
+        bool setIntegerByte(std::span<uint8_t> integer, uint8_t byte);
+
+        uint8_t getFieldByte(Field field);
+        std::span<uint8_t> getIntegerField(Field field);
+        // Empty buffer and null length for fields that aren't strings.
+        StringField getStringField(Field field);
+        std::string_view getString(Field field);
+
+        void reserveUser();
+        // Frees the reserved slot unless the user was created in it.
+        void releaseReservedUser();
+
+        // Checks done as soon as a field is complete, before the rest of the request arrives.
+        void checkField(Field field);
+
+        static Error convertError(AuthenticationError authenticationError);
+
+        // Runs the read operation of the current operation, measuring it when the metrics are compiled in.
+        void executeOperation();
+
+        // Read operations, executed once the request is complete.
+        void logIn();
+        void logOut();
+        void createUser();
+        void deleteUser();
+
+        void modifyOwnUsername();
+        void modifyOwnPassword();
+        void modifyOwnName();
+
+        void modifyUsername();
+        void modifyPassword();
+        void modifyName();
+        void modifyPermission();
+};
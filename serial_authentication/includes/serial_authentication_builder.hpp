@@ -19,7 +19,7 @@ class SerialAuthentication::Builder
         Builder& setPasswordBuffer(std::span<char> passwordBuffer);
         Builder& setPassword2Buffer(std::span<char> password2Buffer);
 
-        SerialAuthentication build();
+        Result<SerialAuthentication> build();
 
     private:
         Configuration configuration;
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <coroutine>
+
+#include "serial_authentication.hpp"
+#include "serial_authentication_builder.hpp"
+
+#ifndef SERIAL_AUTHENTICATION_COROUTINE_FRAMES
+#define SERIAL_AUTHENTICATION_COROUTINE_FRAMES 4
+#endif
+
+#ifndef SERIAL_AUTHENTICATION_COROUTINE_FRAME_SIZE
+#define SERIAL_AUTHENTICATION_COROUTINE_FRAME_SIZE 256
+#endif
+
+// Drives the unframed serial protocol with one coroutine per operation.
+// Each sequence co_awaits the fields of the request in order and co_yields the
+// response, the error code is sent once the sequence finishes.
+//
+// Coroutine frames are taken from a static pool of SERIAL_AUTHENTICATION_COROUTINE_FRAMES
+// slots of SERIAL_AUTHENTICATION_COROUTINE_FRAME_SIZE bytes, one per driver with an
+// operation in progress. If the pool is exhausted, or the frame of a sequence is
+// larger than a slot, the operation fails with InternalError.
+class CoroutineSerialAuthentication : public SerialAuthentication
+{
+    public:
+        static constexpr size_t FrameSize = SERIAL_AUTHENTICATION_COROUTINE_FRAME_SIZE;
+
+        // Size of the largest frame of every sequence with the compiler and flags in use.
+        // Check it against FrameSize once at startup, a larger frame makes every operation fail.
+        static size_t getLargestFrameSize();
+
+        CoroutineSerialAuthentication(const SerialAuthentication& parser);
+        ~CoroutineSerialAuthentication();
+
+        CoroutineSerialAuthentication(const CoroutineSerialAuthentication&) = delete;
+        CoroutineSerialAuthentication& operator=(const CoroutineSerialAuthentication&) = delete;
+
+        void setOperation(Operation newOperation) override;
+
+        void authenticateNextByte(uint8_t byte) override;
+        uint8_t getNextByte() override;
+
+    protected:
+        class Sequence;
+        using SequenceStart = Sequence (CoroutineSerialAuthentication::*)();
+
+        static const std::array<SequenceStart, OperationsAmount> sequences;
+
+        // Suspends the sequence until the field is received. After an error the
+        // remaining fields are still consumed, like in the base parser, so the
+        // request ends where the master expects it to. They are only skipped
+        // when the master reads the response before the request is complete.
+        struct FieldAwaiter
+        {
+            CoroutineSerialAuthentication* driver;
+            Field field;
+
+            bool await_ready() const noexcept;
+            void await_suspend(std::coroutine_handle<>) const noexcept;
+            void await_resume() const;
+        };
+
+        std::coroutine_handle<> sequence;
+
+        // Field the sequence is waiting for, None if it isn't reading.
+        Field awaitedField = Field::None;
+        // Set when the master reads before the end of a failed request.
+        bool skipFields = false;
+        // Bytes yielded by the sequence and not sent yet.
+        std::span<const uint8_t> output;
+
+        void resume();
+        void destroySequence();
+
+        FieldAwaiter read(Field field);
+        // Bytes of the response field, or zeros of the same length after an error.
+        std::span<const uint8_t> respond(Field field);
+
+        Sequence logInSequence();
+        Sequence logOutSequence();
+        Sequence createUserSequence();
+        Sequence deleteUserSequence();
+
+        Sequence modifyOwnUsernameSequence();
+        Sequence modifyOwnPasswordSequence();
+        Sequence modifyOwnNameSequence();
+
+        Sequence modifyUsernameSequence();
+        Sequence modifyPasswordSequence();
+        Sequence modifyNameSequence();
+        Sequence modifyPermissionSequence();
+};
+
+template <size_t BuffersSize>
+class CoroutineSerialAuthenticationStatic : public CoroutineSerialAuthentication
+{
+    protected:
+        std::array<char, BuffersSize> usernameBuffer, password1Buffer, password2Buffer, nameBuffer;
+
+    public:
+        CoroutineSerialAuthenticationStatic(Authentication& authentication) :
+            CoroutineSerialAuthentication(
+                SerialAuthentication(Configuration{
+                    .authentication = &authentication,
+                    .usernameBuffer = usernameBuffer,
+                    .nameBuffer = nameBuffer,
+                    .passwordBuffer = password1Buffer,
+                    .password2Buffer = password2Buffer,
+                })
+            )
+        {}
+};
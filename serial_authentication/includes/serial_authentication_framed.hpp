@@ -0,0 +1,91 @@
+#pragma once
+
+#include "serial_authentication.hpp"
+#include "serial_authentication_builder.hpp"
+
+// Framed variant of the serial protocol. The operation travels in-band and a
+// corrupted or truncated frame is dropped as a whole, so the next frame is
+// parsed correctly without the master having to set the operation again.
+//
+// Request:  Start | Id | Operation | Length (2 bytes) | Request fields | CRC-16 (2 bytes)
+// Response: Start | Id | Operation | Length (2 bytes) | Response field, Error code | CRC-16 (2 bytes)
+//
+// A frame with an unknown operation is answered with the InvalidOperation error code.
+//
+// Length counts the bytes between the header and the CRC. The CRC is CRC-16/CCITT-FALSE
+// over every byte after the start byte. Multi-byte values are little endian.
+//
+// Requests may be pipelined: the master can send several requests without
+// waiting, and the responses are queued in the same order, each carrying the id
+// of its request. Requests received while the response queue is full wait in the
+// frame buffer, bytes that don't fit in the frame buffer are dropped.
+class FramedSerialAuthentication : public SerialAuthentication
+{
+    public:
+        static constexpr uint8_t Start = 0x7E;
+        static constexpr size_t HeaderSize = 5;
+        static constexpr size_t CrcSize = 2;
+        static constexpr size_t MaxResponsePayloadSize = sizeof(Session::TokenType) + 1;
+
+        struct ResponseFrame
+        {
+            std::array<uint8_t, HeaderSize + MaxResponsePayloadSize + CrcSize> bytes;
+            uint8_t length;
+        };
+
+        FramedSerialAuthentication(const SerialAuthentication& parser, std::span<uint8_t> frameStorage, std::span<ResponseFrame> responsesStorage);
+
+        // Frames are received and answered through the same calls used by the unframed protocol.
+        void authenticateNextByte(uint8_t byte) override;
+        uint8_t getNextByte() override;
+
+        // The operation travels in each frame, so setting it from outside does nothing.
+        void setOperation(Operation newOperation) override;
+
+        // Frames are accepted at any time.
+        bool isReading() const override;
+        bool isResponding() const override;
+
+        bool hasResponse() const;
+
+    protected:
+        std::span<uint8_t> frame;
+        size_t frameLength = 0;
+
+        // Ring of responses waiting to be read, the first one possibly read partially.
+        std::span<ResponseFrame> responses;
+        size_t responsesHead = 0;
+        size_t responsesCount = 0;
+        size_t responseIndex = 0;
+
+        // Handles every complete frame in the buffer, dropping the invalid ones.
+        void parseFrames();
+        // Discards the current frame start and moves to the next start byte received.
+        void resync();
+        void execute(uint8_t id, uint8_t operationCode, std::span<const uint8_t> payload, ResponseFrame& response);
+        bool matchesRequest(std::span<const uint8_t> payload);
+};
+
+template <size_t BuffersSize, size_t PipelineDepth = 4, size_t FrameSize = PipelineDepth * (4 * BuffersSize + 16)>
+class FramedSerialAuthenticationStatic : public FramedSerialAuthentication
+{
+    protected:
+        std::array<char, BuffersSize> usernameBuffer, password1Buffer, password2Buffer, nameBuffer;
+        std::array<uint8_t, FrameSize> frameBuffer;
+        std::array<ResponseFrame, PipelineDepth> responsesBuffer;
+
+    public:
+        FramedSerialAuthenticationStatic(Authentication& authentication) :
+            FramedSerialAuthentication(
+                SerialAuthentication(Configuration{
+                    .authentication = &authentication,
+                    .usernameBuffer = usernameBuffer,
+                    .nameBuffer = nameBuffer,
+                    .passwordBuffer = password1Buffer,
+                    .password2Buffer = password2Buffer,
+                }),
+                frameBuffer,
+                responsesBuffer
+            )
+        {}
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+
+#include "serial_authentication.hpp"
+#include "serial_authentication_builder.hpp"
+
+// Serves several serial channels with a single Authentication.
+// Each channel keeps its own parser state, but the string buffers are leased
+// from a shared pool only while a request that needs them is being read.
+// Memory grows with the operations in flight instead of with the channels.
+class SerialAuthenticationHub
+{
+    public:
+        using ChannelId = uint8_t;
+
+        class Channel : public SerialAuthentication
+        {
+            public:
+                static constexpr uint8_t NoBuffers = 0xFF;
+
+                Channel();
+
+                void attach(Authentication& authentication, std::span<uint8_t> queueStorage);
+
+                // Producer side of the receive queue, safe to call from an interrupt.
+                bool push(uint8_t byte);
+                bool pop(uint8_t* byte);
+                bool isQueueEmpty() const;
+
+                // True while the request being read stores bytes in the string buffers.
+                bool needsBuffers() const;
+                bool hasBuffers() const;
+                uint8_t getBuffersSlot() const;
+                void setBuffers(uint8_t slot, std::span<char> slotStorage);
+                void clearBuffers();
+
+                void abort();
+
+            protected:
+                std::span<uint8_t> queue;
+                std::atomic<uint16_t> queueHead = 0;
+                std::atomic<uint16_t> queueTail = 0;
+
+                uint8_t buffersSlot = NoBuffers;
+        };
+
+        SerialAuthenticationHub(Authentication& authentication, std::span<Channel> channels, std::span<char> buffersPool, std::span<bool> buffersInUse, size_t buffersSize);
+
+        // Bytes queued before the operation change are processed with the previous operation.
+        void setOperation(ChannelId channel, SerialAuthentication::Operation operation);
+
+        // Returns false if the channel queue is full and the byte was dropped.
+        bool receive(ChannelId channel, uint8_t byte);
+
+        // Processes every queued byte of the channel before reading the response.
+        // If no buffers are available for the request it fails with an error code.
+        uint8_t getNextByte(ChannelId channel);
+
+        // Processes up to maxBytes queued bytes, taking one byte from each channel in turns.
+        // Returns the amount of bytes processed.
+        size_t service(size_t maxBytes);
+
+        size_t getChannelsAmount() const;
+        size_t getFreeBuffers() const;
+
+    protected:
+        Authentication* authentication;
+
+        std::span<Channel> channels;
+        std::span<char> buffersPool;
+        std::span<bool> buffersInUse;
+        size_t buffersSize;
+
+        // Channel that gets the first turn in the next service round.
+        size_t nextChannel = 0;
+
+        bool process(Channel& channel);
+        void drain(Channel& channel);
+
+        bool leaseBuffers(Channel& channel);
+        void releaseBuffers(Channel& channel);
+};
+
+template <size_t ChannelsAmount, size_t BuffersInFlight, size_t BuffersSize, size_t QueueSize = 16>
+class SerialAuthenticationHubStatic : public SerialAuthenticationHub
+{
+    protected:
+        // Every slot holds the username, password, password 2 and name buffers.
+        static constexpr size_t SlotSize = 4 * BuffersSize;
+
+        std::array<Channel, ChannelsAmount> channelsStorage;
+        std::array<std::array<uint8_t, QueueSize>, ChannelsAmount> queuesStorage;
+        std::array<char, BuffersInFlight * SlotSize> buffersStorage;
+        std::array<bool, BuffersInFlight> buffersInUseStorage{};
+
+    public:
+        SerialAuthenticationHubStatic(Authentication& authentication)
+            : SerialAuthenticationHub(authentication, channelsStorage, buffersStorage, buffersInUseStorage, BuffersSize)
+        {
+            for (size_t i = 0; i < ChannelsAmount; i++)
+            {
+                channelsStorage[i].attach(authentication, queuesStorage[i]);
+                channelsStorage[i].setChannel(i);
+            }
+        };
+};
@@ -11,13 +11,13 @@ class SerialAuthenticationStatic : public SerialAuthentication
     public:
         SerialAuthenticationStatic(Authentication& authentication) :
             SerialAuthentication(
-                SerialAuthentication::Builder()
-                    .setAuthentication(authentication)
-                    .setUsernameBuffer(usernameBuffer)
-                    .setPasswordBuffer(password1Buffer)
-                    .setPassword2Buffer(password2Buffer)
-                    .setNameBuffer(nameBuffer)
-                    .build()
+                Configuration{
+                    .authentication = &authentication,
+                    .usernameBuffer = usernameBuffer,
+                    .nameBuffer = nameBuffer,
+                    .passwordBuffer = password1Buffer,
+                    .password2Buffer = password2Buffer,
+                }
             )
         {}
 };
\ No newline at end of file
@@ -1,9 +1,39 @@
 #include "serial_authentication.hpp"
 #include "serial_authentication_builder.hpp"
 
-#include <stdexcept>
 #include <utility>
 
+constexpr std::array<SerialAuthentication::OperationLayout, SerialAuthentication::OperationsAmount> SerialAuthentication::operationLayouts
+{{
+    // Idle
+    {{}, Field::None, Permission::None, false, nullptr},
+
+    // LogIn
+    {{Field::Username, Field::Password}, Field::Token, Permission::None, false, &SerialAuthentication::logIn},
+    // LogOut
+    {{Field::Token}, Field::None, Permission::None, false, &SerialAuthentication::logOut},
+    // CreateUser
+    {{Field::Token, Field::NewUsername, Field::Password, Field::Permission}, Field::UserId, Permission::Superuser, true, &SerialAuthentication::createUser},
+    // DeleteUser
+    {{Field::Token, Field::UserId}, Field::None, Permission::Superuser, false, &SerialAuthentication::deleteUser},
+
+    // ModifyOwnUsername
+    {{Field::Token, Field::NewUsername}, Field::None, Permission::None, false, &SerialAuthentication::modifyOwnUsername},
+    // ModifyOwnPassword
+    {{Field::Token, Field::Password, Field::Password2}, Field::None, Permission::None, false, &SerialAuthentication::modifyOwnPassword},
+    // ModifyOwnName
+    {{Field::Token, Field::Name}, Field::None, Permission::None, false, &SerialAuthentication::modifyOwnName},
+
+    // ModifyUsername
+    {{Field::Token, Field::UserId, Field::NewUsername}, Field::None, Permission::Superuser, false, &SerialAuthentication::modifyUsername},
+    // ModifyPassword
+    {{Field::Token, Field::UserId, Field::Password}, Field::None, Permission::Superuser, false, &SerialAuthentication::modifyPassword},
+    // ModifyName
+    {{Field::Token, Field::UserId, Field::Name}, Field::None, Permission::Superuser, false, &SerialAuthentication::modifyName},
+    // ModifyPermission
+    {{Field::Token, Field::UserId, Field::Permission}, Field::None, Permission::Superuser, false, &SerialAuthentication::modifyPermission},
+}};
+
 SerialAuthentication::SerialAuthentication(const Configuration& configuration) :
     authentication(configuration.authentication),
     currentUsername(configuration.usernameBuffer),
@@ -14,273 +44,259 @@ SerialAuthentication::SerialAuthentication(const Configuration& configuration) :
 
 }
 
+uint8_t SerialAuthentication::getInvalidOperationCode()
+{
+    return std::to_underlying(Error::InvalidOperation);
+}
+
+void SerialAuthentication::setChannel(LoginThrottle::ChannelId newChannel)
+{
+    channel = newChannel;
+}
+
+#ifdef AUTHENTICATION_METRICS
+SerialAuthentication::Metrics& SerialAuthentication::getMetrics()
+{
+    static Metrics metrics;
+    return metrics;
+}
+#endif
+
+void SerialAuthentication::executeOperation()
+{
+#ifdef AUTHENTICATION_METRICS
+    MetricsTimer timer;
+    (this->*getLayout().execute)();
+    getMetrics().record(std::to_underlying(operation), timer.getElapsed(), error != Error::None);
+#else
+    (this->*getLayout().execute)();
+#endif
+}
+
+const SerialAuthentication::OperationLayout& SerialAuthentication::getLayout() const
+{
+    return operationLayouts[std::to_underlying(operation)];
+}
+
 void SerialAuthentication::authenticateNextByte(uint8_t byte)
 {
-    State previousState = state;
-    switch(operation)
-    {
-        case Operation::Idle:
-            break;
-
-        case Operation::LogIn:
-            logIn(byte);
-            break;
-        case Operation::LogOut:
-            logOut(byte);
-            break;
-        case Operation::CreateUser:
-            createUser(byte);
-            break;
-        case Operation::DeleteUser:
-            deleteUser(byte);
-            break;
-
-        case Operation::ModifyOwnUsername:
-            modifyOwnUsername(byte);
-            break;
-        case Operation::ModifyOwnPassword:
-            modifyOwnPassword(byte);
-            break;
-        case Operation::ModifyOwnName:
-            modifyOwnName(byte);
-            break;
-
-        case Operation::ModifyUsername:
-            modifyUsername(byte);
-            break;
-        case Operation::ModifyPassword:
-            modifyPassword(byte);
-            break;
-        case Operation::ModifyName:
-            modifyName(byte);
-            break;
-        case Operation::ModifyPermission:
-            modifyPermission(byte);
-            break;
-    }
+    if(state != State::Reading)
+        return;
 
-    if(error != Error::None)
-        state = State::Error;
+    const OperationLayout& layout = getLayout();
+    Field field = layout.request[currentFieldIndex];
 
-    if(previousState != state)
-        currentByteIndex = 0;
+    if(!setFieldByte(field, byte))
+        return;
+
+    // After an error the remaining fields are still consumed,
+    // so the request ends where the master expects it to.
+    if(error == Error::None)
+        checkField(field);
+
+    currentByteIndex = 0;
+    currentFieldIndex++;
+    if(currentFieldIndex < MaxRequestFields && layout.request[currentFieldIndex] != Field::None)
+        return;
+
+    if(error == Error::None)
+        executeOperation();
+
+    releaseReservedUser();
+    state = State::Sending;
 }
 
 uint8_t SerialAuthentication::getNextByte()
 {
-    uint8_t byte = 0;
-    State previousState = state;
+    // Error handling, common for all operations. The master may read
+    // as soon as the error happens, without finishing the request.
+    if(state == State::Reading && error != Error::None)
+        state = State::Sending;
 
-    // Error handling, common for all operations.
-    if(state == State::Error)
-        if(writesUntilErrorCode-- == 0)
-            state = State::SendingErrorCode;
+    if(state == State::Sending && writesUntilErrorCode == 0)
+        state = State::SendingErrorCode;
 
-    if(state == State::SendingErrorCode)
+    switch(state)
     {
-        state = State::None;
-        return std::to_underlying(error);
+        case State::Sending:
+            writesUntilErrorCode--;
+            if(error != Error::None)
+                return 0;
+            return getFieldByte(getLayout().response);
+
+        case State::SendingErrorCode:
+            state = State::None;
+            return std::to_underlying(error);
+
+        default:
+            return 0;
     }
+}
 
-    switch(operation)
-    {
-        case Operation::Idle:
-            break;
-
-        case Operation::LogIn:
-            byte = logIn();
-            break;
-        case Operation::LogOut:
-            // Error code only.
-            break;
-        case Operation::CreateUser:
-            byte = createUser();
-            break;
-        case Operation::DeleteUser:
-            break;
-
-        case Operation::ModifyOwnUsername:
-            break;
-        case Operation::ModifyOwnPassword:
-            break;
-        case Operation::ModifyOwnName:
-            break;
-
-        case Operation::ModifyUsername:
-            break;
-        case Operation::ModifyPassword:
-            break;
-        case Operation::ModifyName:
-            break;
-        case Operation::ModifyPermission:
-            break;
-    }
+size_t SerialAuthentication::authenticateBytes(std::span<const uint8_t> bytes)
+{
+    size_t read = 0;
+    while(read < bytes.size() && isReading())
+        authenticateNextByte(bytes[read++]);
 
+    return read;
+}
 
-    if(error != Error::None)
-        state = State::Error;
+size_t SerialAuthentication::getNextBytes(std::span<uint8_t> bytes)
+{
+    size_t written = 0;
+    while(written < bytes.size() && isResponding())
+        bytes[written++] = getNextByte();
 
-    if(previousState != state)
-        currentByteIndex = 0;
+    return written;
+}
 
-    return byte;
+bool SerialAuthentication::isReading() const
+{
+    return state == State::Reading;
+}
+
+bool SerialAuthentication::isResponding() const
+{
+    return state == State::Sending || state == State::SendingErrorCode;
 }
 
 void SerialAuthentication::setOperation(Operation newOperation)
 {
+    if(static_cast<size_t>(std::to_underlying(newOperation)) >= OperationsAmount)
+        newOperation = Operation::Idle;
+
+    releaseReservedUser();
+
     operation = newOperation;
     error = Error::None;
     currentByteIndex = 0;
-    switch(operation)
+    currentFieldIndex = 0;
+
+    const OperationLayout& layout = getLayout();
+    if(layout.request[0] == Field::None)
     {
-        case Operation::Idle:
-            break;
-
-        case Operation::LogIn:
-            writesUntilErrorCode = sizeof(Session::TokenType);
-            state = State::ReadingUser;
-            break;
-
-        case Operation::LogOut:
-            writesUntilErrorCode = 0;
-            state = State::ReadingToken;
-            break;
-
-        case Operation::CreateUser:
-            writesUntilErrorCode = sizeof(User::IdType);
-            state = State::ReadingToken;
-            break;
-
-        case Operation::DeleteUser:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyOwnUsername:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyOwnPassword:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyOwnName:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyUsername:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyPassword:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyName:
-            state = State::ReadingToken;
-            break;
-
-        case Operation::ModifyPermission:
-            state = State::ReadingToken;
-            break;
+        state = State::None;
+        writesUntilErrorCode = 0;
+        return;
     }
+
+    writesUntilErrorCode = getIntegerField(layout.response).size();
+    state = State::Reading;
 }
 
-bool SerialAuthentication::setUsernameByte(uint8_t byte)
+bool SerialAuthentication::setFieldByte(Field field, uint8_t byte)
 {
-    if(currentByteIndex >= currentUsername.size())
-    {
-        error = Error::UsernameOverflow;
-        return true;
-    }
-
-    currentUsername[currentByteIndex++] = byte;
-    if(byte == '\0')
-        return true;
+    StringField string = getStringField(field);
+    if(string.length)
+        return setStringByte(string, byte);
 
-    return false;
+    return setIntegerByte(getIntegerField(field), byte);
 }
 
-bool SerialAuthentication::setPasswordByte(uint8_t byte)
+bool SerialAuthentication::setStringByte(const StringField& string, uint8_t byte)
 {
-    if(currentByteIndex >= currentPassword.size())
+    // After an error the string won't be used, so it isn't stored.
+    if(error != Error::None)
+        return byte == '\0';
+
+    if(currentByteIndex >= string.buffer.size())
     {
-        error = Error::UsernameOverflow;
-        return true;
+        error = string.overflowError;
+        return byte == '\0';
     }
 
-    currentPassword[currentByteIndex++] = byte;
+    string.buffer[currentByteIndex] = byte;
     if(byte == '\0')
+    {
+        *string.length = currentByteIndex;
         return true;
+    }
 
+    currentByteIndex++;
     return false;
 }
 
-bool SerialAuthentication::setPassword2Byte(uint8_t byte)
+bool SerialAuthentication::setIntegerByte(std::span<uint8_t> integer, uint8_t byte)
 {
-    if(currentByteIndex >= currentPassword2.size())
-    {
-        error = Error::UsernameOverflow;
-        return true;
-    }
+    if(currentByteIndex < integer.size())
+        integer[currentByteIndex++] = byte;
 
-    currentPassword2[currentByteIndex++] = byte;
-    if(byte == '\0')
-        return true;
-
-    return false;
+    return currentByteIndex >= integer.size();
 }
 
-bool SerialAuthentication::setNameByte(uint8_t byte)
+std::span<uint8_t> SerialAuthentication::getIntegerField(Field field)
 {
-    if(currentByteIndex >= currentName.size())
+    switch(field)
     {
-        error = Error::UsernameOverflow;
-        return true;
-    }
+        case Field::Token:
+            return std::span(reinterpret_cast<uint8_t*>(&currentToken), sizeof(currentToken));
 
-    currentName[currentByteIndex++] = byte;
-    if(byte == '\0')
-        return true;
+        case Field::UserId:
+            return std::span(reinterpret_cast<uint8_t*>(&currentId), sizeof(currentId));
 
-    return false;
+        case Field::Permission:
+            return std::span(reinterpret_cast<uint8_t*>(&currentPermissionId), sizeof(currentPermissionId));
+
+        default:
+            return {};
+    }
 }
 
-bool SerialAuthentication::setIdByte(uint8_t byte)
+SerialAuthentication::StringField SerialAuthentication::getStringField(Field field)
 {
-    if(currentByteIndex < sizeof(currentId))
-        reinterpret_cast<uint8_t*>(&currentId)[currentByteIndex++] = byte;
+    switch(field)
+    {
+        case Field::Username:
+            return {currentUsername, &currentUsernameLength, Error::UsernameOverflow};
 
-    return currentByteIndex >= sizeof(currentId);
-}
+        case Field::NewUsername:
+            if(reservedUser)
+                return {reservedUser->getUsernameStorage(), &currentUsernameLength, Error::UsernameOverflow};
+            return {currentUsername, &currentUsernameLength, Error::UsernameOverflow};
 
-bool SerialAuthentication::setPermissionByte(uint8_t byte)
-{
-    if(currentByteIndex < sizeof(currentPermissionId))
-        reinterpret_cast<uint8_t*>(&currentPermissionId)[currentByteIndex++] = byte;
+        case Field::Password:
+            if(reservedUser)
+                return {reservedUser->getPasswordStorage(), &currentPasswordLength, Error::PasswordOverflow};
+            return {currentPassword, &currentPasswordLength, Error::PasswordOverflow};
+
+        case Field::Password2:
+            return {currentPassword2, &currentPassword2Length, Error::PasswordOverflow};
 
-    return currentByteIndex >= sizeof(currentPermissionId);
+        case Field::Name:
+            return {currentName, &currentNameLength, Error::NameOverflow};
+
+        default:
+            return {{}, nullptr, Error::None};
+    }
 }
 
-bool SerialAuthentication::setTokenByte(uint8_t byte)
+std::string_view SerialAuthentication::getString(Field field)
 {
-    if(currentByteIndex < sizeof(currentToken))
-        reinterpret_cast<uint8_t*>(&currentToken)[currentByteIndex++] = byte;
+    StringField string = getStringField(field);
+    if(!string.length)
+        return {};
 
-    return currentByteIndex >= sizeof(currentToken);
+    return std::string_view(string.buffer.data(), *string.length);
 }
 
-bool SerialAuthentication::getIdByte(uint8_t* byte)
+void SerialAuthentication::reserveUser()
 {
-    if(currentByteIndex < sizeof(currentId))
-        *byte = reinterpret_cast<uint8_t*>(&currentId)[currentByteIndex++];
+    auto user = authentication->getUserManager()->reserveUser();
+    if(!user)
+    {
+        error = convertError(user.error());
+        return;
+    }
 
-    return currentByteIndex >= sizeof(currentId);
+    reservedUser = *user;
 }
 
-bool SerialAuthentication::getTokenByte(uint8_t* byte)
+void SerialAuthentication::releaseReservedUser()
 {
-    if(currentByteIndex < sizeof(currentToken))
-        *byte = reinterpret_cast<uint8_t*>(&currentToken)[currentByteIndex++];
+    if(!reservedUser)
+        return;
 
-    return currentByteIndex >= sizeof(currentToken);
+    authentication->getUserManager()->releaseUser(*reservedUser);
+    reservedUser = nullptr;
 }
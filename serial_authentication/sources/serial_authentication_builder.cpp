@@ -1,7 +1,5 @@
 #include "serial_authentication_builder.hpp"
 
-#include <stdexcept>
-
 SerialAuthentication::Builder& SerialAuthentication::Builder::setAuthentication(Authentication& authentication)
 {
     configuration.authentication = &authentication;
@@ -32,7 +30,7 @@ SerialAuthentication::Builder& SerialAuthentication::Builder::setPassword2Buffer
     return *this;
 }
 
-SerialAuthentication SerialAuthentication::Builder::build()
+Result<SerialAuthentication> SerialAuthentication::Builder::build()
 {
     if(
         configuration.authentication == nullptr ||
@@ -41,7 +39,7 @@ SerialAuthentication SerialAuthentication::Builder::build()
         configuration.passwordBuffer.empty() ||
         configuration.password2Buffer.empty()
     )
-        throw std::logic_error("Incomplete configuration.");
+        return ::Error(AuthenticationError::IncompleteConfiguration);
 
     return SerialAuthentication(configuration);
 }
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "serial_authentication_coroutine.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+static constexpr size_t FrameSize = CoroutineSerialAuthentication::FrameSize;
+
+alignas(std::max_align_t) static std::array<std::array<std::byte, FrameSize>, SERIAL_AUTHENTICATION_COROUTINE_FRAMES> frames;
+static std::array<bool, SERIAL_AUTHENTICATION_COROUTINE_FRAMES> framesInUse;
+// Largest frame requested so far, even if it didn't fit.
+static size_t largestFrameSize = 0;
+
+class CoroutineSerialAuthentication::Sequence
+{
+    public:
+        struct promise_type
+        {
+            CoroutineSerialAuthentication* driver;
+
+            promise_type(CoroutineSerialAuthentication& driver) : driver(&driver) {}
+
+            Sequence get_return_object()
+            {
+                return Sequence(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            static Sequence get_return_object_on_allocation_failure()
+            {
+                return Sequence(nullptr);
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+
+            std::suspend_always yield_value(std::span<const uint8_t> bytes) noexcept
+            {
+                driver->output = bytes;
+                return {};
+            }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception() noexcept
+            {
+                driver->error = Error::InternalError;
+            }
+
+            static void* operator new(size_t size) noexcept
+            {
+                largestFrameSize = std::max(largestFrameSize, size);
+                if(size > FrameSize)
+                    return nullptr;
+
+                auto it = std::find(framesInUse.begin(), framesInUse.end(), false);
+                if(it == framesInUse.end())
+                    return nullptr;
+
+                *it = true;
+                return frames[it - framesInUse.begin()].data();
+            }
+
+            static void operator delete(void* frame) noexcept
+            {
+                auto isFrame = [&](const auto& slot) {return slot.data() == frame;};
+                auto it = std::find_if(frames.begin(), frames.end(), isFrame);
+                if(it != frames.end())
+                    framesInUse[it - frames.begin()] = false;
+            }
+        };
+
+        Sequence(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        std::coroutine_handle<> release()
+        {
+            return std::exchange(handle, nullptr);
+        }
+
+    protected:
+        std::coroutine_handle<promise_type> handle;
+};
+
+constexpr std::array<CoroutineSerialAuthentication::SequenceStart, SerialAuthentication::OperationsAmount> CoroutineSerialAuthentication::sequences
+{
+    nullptr,
+
+    &CoroutineSerialAuthentication::logInSequence,
+    &CoroutineSerialAuthentication::logOutSequence,
+    &CoroutineSerialAuthentication::createUserSequence,
+    &CoroutineSerialAuthentication::deleteUserSequence,
+
+    &CoroutineSerialAuthentication::modifyOwnUsernameSequence,
+    &CoroutineSerialAuthentication::modifyOwnPasswordSequence,
+    &CoroutineSerialAuthentication::modifyOwnNameSequence,
+
+    &CoroutineSerialAuthentication::modifyUsernameSequence,
+    &CoroutineSerialAuthentication::modifyPasswordSequence,
+    &CoroutineSerialAuthentication::modifyNameSequence,
+    &CoroutineSerialAuthentication::modifyPermissionSequence,
+};
+
+size_t CoroutineSerialAuthentication::getLargestFrameSize()
+{
+    // Sequences start suspended, so creating each one only allocates its frame.
+    CoroutineSerialAuthentication driver(SerialAuthentication(Configuration{}));
+    for(SequenceStart start : sequences)
+    {
+        if(!start)
+            continue;
+
+        std::coroutine_handle<> handle = (driver.*start)().release();
+        if(handle)
+            handle.destroy();
+    }
+
+    return largestFrameSize;
+}
+
+CoroutineSerialAuthentication::CoroutineSerialAuthentication(const SerialAuthentication& parser)
+    : SerialAuthentication(parser)
+{}
+
+CoroutineSerialAuthentication::~CoroutineSerialAuthentication()
+{
+    destroySequence();
+}
+
+void CoroutineSerialAuthentication::setOperation(Operation newOperation)
+{
+    destroySequence();
+    SerialAuthentication::setOperation(newOperation);
+
+    SequenceStart start = sequences[std::to_underlying(operation)];
+    if(!start)
+        return;
+
+    sequence = (this->*start)().release();
+
+    // Without a frame the base parser pads the response and sends the error code.
+    if(!sequence)
+    {
+        error = Error::InternalError;
+        state = State::Sending;
+        return;
+    }
+
+    resume();
+}
+
+void CoroutineSerialAuthentication::authenticateNextByte(uint8_t byte)
+{
+    if(!sequence || awaitedField == Field::None)
+        return;
+
+    if(!setFieldByte(awaitedField, byte))
+        return;
+
+    resume();
+}
+
+uint8_t CoroutineSerialAuthentication::getNextByte()
+{
+    if(!sequence)
+        return SerialAuthentication::getNextByte();
+
+    if(!output.empty())
+    {
+        uint8_t byte = output.front();
+        output = output.subspan(1);
+        if(output.empty())
+            resume();
+        return byte;
+    }
+
+    if(sequence.done())
+    {
+        destroySequence();
+        state = State::None;
+        return std::to_underlying(error);
+    }
+
+    // Like the base parser, the master may read as soon as an error happens
+    // without finishing the request, then the sequence runs to the response.
+    if(awaitedField != Field::None && error != Error::None)
+    {
+        skipFields = true;
+        resume();
+        return getNextByte();
+    }
+
+    // The request is still being received.
+    return 0;
+}
+
+void CoroutineSerialAuthentication::resume()
+{
+    awaitedField = Field::None;
+    currentByteIndex = 0;
+    sequence.resume();
+
+    // Kept up to date so isReading and isResponding describe the sequence.
+    state = awaitedField != Field::None ? State::Reading : State::Sending;
+}
+
+void CoroutineSerialAuthentication::destroySequence()
+{
+    if(sequence)
+        sequence.destroy();
+
+    sequence = nullptr;
+    awaitedField = Field::None;
+    skipFields = false;
+    output = {};
+    releaseReservedUser();
+}
+
+bool CoroutineSerialAuthentication::FieldAwaiter::await_ready() const noexcept
+{
+    return driver->skipFields;
+}
+
+void CoroutineSerialAuthentication::FieldAwaiter::await_suspend(std::coroutine_handle<>) const noexcept
+{
+    driver->awaitedField = field;
+}
+
+void CoroutineSerialAuthentication::FieldAwaiter::await_resume() const
+{
+    if(driver->error == Error::None)
+        driver->checkField(field);
+}
+
+CoroutineSerialAuthentication::FieldAwaiter CoroutineSerialAuthentication::read(Field field)
+{
+    return FieldAwaiter{this, field};
+}
+
+std::span<const uint8_t> CoroutineSerialAuthentication::respond(Field field)
+{
+    static constexpr std::array<uint8_t, sizeof(Session::TokenType)> zeros{};
+
+    auto bytes = getIntegerField(field);
+    if(error != Error::None)
+        return std::span(zeros).first(bytes.size());
+
+    return bytes;
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::logInSequence()
+{
+    co_await read(Field::Username);
+    co_await read(Field::Password);
+
+    if(error == Error::None)
+        executeOperation();
+
+    co_yield respond(Field::Token);
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::logOutSequence()
+{
+    co_await read(Field::Token);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::createUserSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::NewUsername);
+    co_await read(Field::Password);
+    co_await read(Field::Permission);
+
+    if(error == Error::None)
+        executeOperation();
+
+    co_yield respond(Field::UserId);
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::deleteUserSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::UserId);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyOwnUsernameSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::NewUsername);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyOwnPasswordSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::Password);
+    co_await read(Field::Password2);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyOwnNameSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::Name);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyUsernameSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::UserId);
+    co_await read(Field::NewUsername);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyPasswordSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::UserId);
+    co_await read(Field::Password);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyNameSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::UserId);
+    co_await read(Field::Name);
+
+    if(error == Error::None)
+        executeOperation();
+}
+
+CoroutineSerialAuthentication::Sequence CoroutineSerialAuthentication::modifyPermissionSequence()
+{
+    co_await read(Field::Token);
+    co_await read(Field::UserId);
+    co_await read(Field::Permission);
+
+    if(error == Error::None)
+        executeOperation();
+}
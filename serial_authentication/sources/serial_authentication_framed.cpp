@@ -0,0 +1,174 @@
+#include "serial_authentication_framed.hpp"
+#include "crc.hpp"
+
+#include <algorithm>
+
+FramedSerialAuthentication::FramedSerialAuthentication(const SerialAuthentication& parser, std::span<uint8_t> frameStorage, std::span<ResponseFrame> responsesStorage)
+    : SerialAuthentication(parser), frame(frameStorage), responses(responsesStorage)
+{}
+
+void FramedSerialAuthentication::authenticateNextByte(uint8_t byte)
+{
+    // Bytes outside of a frame are noise.
+    if(frameLength == 0 && byte != Start)
+        return;
+
+    if(frameLength == frame.size())
+        return;
+
+    frame[frameLength++] = byte;
+    parseFrames();
+}
+
+uint8_t FramedSerialAuthentication::getNextByte()
+{
+    if(!hasResponse())
+        return 0;
+
+    const ResponseFrame& response = responses[responsesHead];
+    uint8_t byte = response.bytes[responseIndex++];
+    if(responseIndex < response.length)
+        return byte;
+
+    responsesHead = (responsesHead + 1) % responses.size();
+    responsesCount--;
+    responseIndex = 0;
+
+    // A response slot was freed, requests waiting for it can be executed.
+    parseFrames();
+    return byte;
+}
+
+void FramedSerialAuthentication::setOperation(Operation)
+{
+}
+
+bool FramedSerialAuthentication::isReading() const
+{
+    return true;
+}
+
+bool FramedSerialAuthentication::isResponding() const
+{
+    return hasResponse();
+}
+
+bool FramedSerialAuthentication::hasResponse() const
+{
+    return responsesCount > 0;
+}
+
+void FramedSerialAuthentication::parseFrames()
+{
+    while(frameLength >= HeaderSize && responsesCount < responses.size())
+    {
+        size_t payloadLength = frame[3] | (frame[4] << 8);
+        size_t totalLength = HeaderSize + payloadLength + CrcSize;
+
+        if(totalLength > frame.size())
+        {
+            resync();
+            continue;
+        }
+
+        if(frameLength < totalLength)
+            return;
+
+        auto checked = std::span<const uint8_t>(frame).subspan(1, HeaderSize - 1 + payloadLength);
+        uint16_t crc = frame[totalLength - 2] | (frame[totalLength - 1] << 8);
+        if(Crc16::compute(checked) != crc)
+        {
+            resync();
+            continue;
+        }
+
+        ResponseFrame& response = responses[(responsesHead + responsesCount) % responses.size()];
+        execute(frame[1], frame[2], checked.subspan(HeaderSize - 1), response);
+        responsesCount++;
+
+        std::copy(frame.begin() + totalLength, frame.begin() + frameLength, frame.begin());
+        frameLength -= totalLength;
+    }
+}
+
+void FramedSerialAuthentication::resync()
+{
+    auto next = std::find(frame.begin() + 1, frame.begin() + frameLength, Start);
+    frameLength = std::copy(next, frame.begin() + frameLength, frame.begin()) - frame.begin();
+}
+
+void FramedSerialAuthentication::execute(uint8_t id, uint8_t operationCode, std::span<const uint8_t> payload, ResponseFrame& response)
+{
+    size_t payloadLength = 0;
+    auto payloadStorage = std::span(response.bytes).subspan(HeaderSize, MaxResponsePayloadSize);
+
+    // The frame is parsed with the unframed protocol of the base parser.
+    if(operationCode >= OperationsAmount)
+        payloadStorage[payloadLength++] = std::to_underlying(Error::InvalidOperation);
+    else
+        SerialAuthentication::setOperation(static_cast<Operation>(operationCode));
+
+    if(operationCode < OperationsAmount && operation != Operation::Idle)
+    {
+        // Nothing is executed unless the payload holds exactly the fields of the request.
+        if(matchesRequest(payload))
+        {
+            for(size_t read = 0; read < payload.size() && SerialAuthentication::isReading(); read++)
+                SerialAuthentication::authenticateNextByte(payload[read]);
+        }
+        else
+            error = Error::ByteReadNotExpected;
+
+        if(state == State::Reading)
+            state = State::Sending;
+
+        while(payloadLength < payloadStorage.size() && SerialAuthentication::isResponding())
+            payloadStorage[payloadLength++] = SerialAuthentication::getNextByte();
+    }
+
+    response.bytes[0] = Start;
+    response.bytes[1] = id;
+    response.bytes[2] = operationCode;
+    response.bytes[3] = payloadLength & 0xFF;
+    response.bytes[4] = payloadLength >> 8;
+
+    uint16_t crc = Crc16::compute(std::span(response.bytes).subspan(1, HeaderSize - 1 + payloadLength));
+    response.bytes[HeaderSize + payloadLength] = crc & 0xFF;
+    response.bytes[HeaderSize + payloadLength + 1] = crc >> 8;
+
+    response.length = HeaderSize + payloadLength + CrcSize;
+}
+
+bool FramedSerialAuthentication::matchesRequest(std::span<const uint8_t> payload)
+{
+    size_t offset = 0;
+    for(Field field : getLayout().request)
+    {
+        switch(field)
+        {
+            case Field::None:
+                break;
+
+            case Field::Username:
+            case Field::NewUsername:
+            case Field::Password:
+            case Field::Password2:
+            case Field::Name:
+            {
+                auto end = std::find(payload.begin() + offset, payload.end(), '\0');
+                if(end == payload.end())
+                    return false;
+                offset = end - payload.begin() + 1;
+                break;
+            }
+
+            default:
+                offset += getIntegerField(field).size();
+                if(offset > payload.size())
+                    return false;
+                break;
+        }
+    }
+
+    return offset == payload.size();
+}
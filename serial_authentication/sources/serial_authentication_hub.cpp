@@ -0,0 +1,225 @@
+#include "serial_authentication_hub.hpp"
+
+#include <algorithm>
+
+SerialAuthenticationHub::Channel::Channel()
+    : SerialAuthentication(Configuration{})
+{}
+
+void SerialAuthenticationHub::Channel::attach(Authentication& authentication, std::span<uint8_t> queueStorage)
+{
+    this->authentication = &authentication;
+    queue = queueStorage;
+}
+
+bool SerialAuthenticationHub::Channel::push(uint8_t byte)
+{
+    uint16_t head = queueHead.load(std::memory_order_relaxed);
+    uint16_t next = (head + 1) % queue.size();
+    if(next == queueTail.load(std::memory_order_acquire))
+        return false;
+
+    queue[head] = byte;
+    queueHead.store(next, std::memory_order_release);
+    return true;
+}
+
+bool SerialAuthenticationHub::Channel::pop(uint8_t* byte)
+{
+    uint16_t tail = queueTail.load(std::memory_order_relaxed);
+    if(tail == queueHead.load(std::memory_order_acquire))
+        return false;
+
+    *byte = queue[tail];
+    queueTail.store((tail + 1) % queue.size(), std::memory_order_release);
+    return true;
+}
+
+bool SerialAuthenticationHub::Channel::isQueueEmpty() const
+{
+    return queueTail.load(std::memory_order_relaxed) == queueHead.load(std::memory_order_acquire);
+}
+
+bool SerialAuthenticationHub::Channel::needsBuffers() const
+{
+    // Once there's an error the rest of the request is skipped without being stored.
+    if(state != State::Reading || error != Error::None)
+        return false;
+
+    const auto& request = getLayout().request;
+    auto isString = [](Field field)
+    {
+        switch(field)
+        {
+            case Field::Username:
+            case Field::NewUsername:
+            case Field::Password:
+            case Field::Password2:
+            case Field::Name:
+                return true;
+            default:
+                return false;
+        }
+    };
+    return std::any_of(request.begin() + currentFieldIndex, request.end(), isString);
+}
+
+bool SerialAuthenticationHub::Channel::hasBuffers() const
+{
+    return buffersSlot != NoBuffers;
+}
+
+uint8_t SerialAuthenticationHub::Channel::getBuffersSlot() const
+{
+    return buffersSlot;
+}
+
+void SerialAuthenticationHub::Channel::setBuffers(uint8_t slot, std::span<char> slotStorage)
+{
+    size_t bufferSize = slotStorage.size() / 4;
+
+    buffersSlot = slot;
+    currentUsername = slotStorage.subspan(0 * bufferSize, bufferSize);
+    currentPassword = slotStorage.subspan(1 * bufferSize, bufferSize);
+    currentPassword2 = slotStorage.subspan(2 * bufferSize, bufferSize);
+    currentName = slotStorage.subspan(3 * bufferSize, bufferSize);
+}
+
+void SerialAuthenticationHub::Channel::clearBuffers()
+{
+    buffersSlot = NoBuffers;
+    currentUsername = {};
+    currentPassword = {};
+    currentPassword2 = {};
+    currentName = {};
+}
+
+void SerialAuthenticationHub::Channel::abort()
+{
+    if(error == Error::None)
+        error = Error::BuffersUnavailable;
+}
+
+SerialAuthenticationHub::SerialAuthenticationHub(Authentication& authentication, std::span<Channel> channels, std::span<char> buffersPool, std::span<bool> buffersInUse, size_t buffersSize)
+    : authentication(&authentication), channels(channels), buffersPool(buffersPool), buffersInUse(buffersInUse), buffersSize(buffersSize)
+{}
+
+void SerialAuthenticationHub::setOperation(ChannelId channel, SerialAuthentication::Operation operation)
+{
+    if(channel >= channels.size())
+        return;
+
+    Channel& selected = channels[channel];
+    drain(selected);
+    releaseBuffers(selected);
+    selected.setOperation(operation);
+}
+
+bool SerialAuthenticationHub::receive(ChannelId channel, uint8_t byte)
+{
+    if(channel >= channels.size())
+        return false;
+
+    return channels[channel].push(byte);
+}
+
+uint8_t SerialAuthenticationHub::getNextByte(ChannelId channel)
+{
+    if(channel >= channels.size())
+        return 0;
+
+    Channel& selected = channels[channel];
+    drain(selected);
+    return selected.getNextByte();
+}
+
+size_t SerialAuthenticationHub::service(size_t maxBytes)
+{
+    size_t processed = 0;
+    size_t idleTurns = 0;
+
+    // Stop after a whole round where no channel could make progress.
+    while(processed < maxBytes && idleTurns < channels.size())
+    {
+        Channel& channel = channels[nextChannel];
+        nextChannel = (nextChannel + 1) % channels.size();
+
+        if(process(channel))
+        {
+            processed++;
+            idleTurns = 0;
+        }
+        else
+        {
+            idleTurns++;
+        }
+    }
+
+    return processed;
+}
+
+size_t SerialAuthenticationHub::getChannelsAmount() const
+{
+    return channels.size();
+}
+
+size_t SerialAuthenticationHub::getFreeBuffers() const
+{
+    return std::count(buffersInUse.begin(), buffersInUse.end(), false);
+}
+
+bool SerialAuthenticationHub::process(Channel& channel)
+{
+    if(channel.isQueueEmpty())
+        return false;
+
+    if(channel.needsBuffers() && !channel.hasBuffers() && !leaseBuffers(channel))
+        return false;
+
+    uint8_t byte = 0;
+    if(!channel.pop(&byte))
+        return false;
+    channel.authenticateNextByte(byte);
+
+    // The operation runs with the last field of the request and the response is
+    // kept in the parser state, so the buffers go back to the pool once it's read.
+    if(!channel.isReading())
+        releaseBuffers(channel);
+
+    return true;
+}
+
+void SerialAuthenticationHub::drain(Channel& channel)
+{
+    while(!channel.isQueueEmpty())
+    {
+        if(process(channel))
+            continue;
+
+        // Without buffers the request can't be read, the remaining bytes are skipped.
+        channel.abort();
+        process(channel);
+    }
+}
+
+bool SerialAuthenticationHub::leaseBuffers(Channel& channel)
+{
+    auto it = std::find(buffersInUse.begin(), buffersInUse.end(), false);
+    if(it == buffersInUse.end())
+        return false;
+
+    *it = true;
+    size_t slot = it - buffersInUse.begin();
+    size_t slotSize = 4 * buffersSize;
+    channel.setBuffers(slot, buffersPool.subspan(slot * slotSize, slotSize));
+    return true;
+}
+
+void SerialAuthenticationHub::releaseBuffers(Channel& channel)
+{
+    if(!channel.hasBuffers())
+        return;
+
+    buffersInUse[channel.getBuffersSlot()] = false;
+    channel.clearBuffers();
+}
@@ -1,166 +1,60 @@
 #include "serial_authentication.hpp"
 
-void SerialAuthentication::readingToken(uint8_t byte, State nextState, Permission permissionNeeded)
+void SerialAuthentication::checkField(Field field)
 {
-    bool done = setTokenByte(byte);
-    if(!done)
-        return;
-
-    const Session* session = authentication->validate(currentToken);
-    if(!session)
+    switch(field)
     {
-        error = Error::TokenInvalid;
-        return;
-    }
-
-    // Don't check if no permission is needed
-    if(permissionNeeded != Permission::None)
-        if(!session->getUser()->hasPermission(permissionNeeded))
+        case Field::Token:
         {
-            error = Error::UserNoPermission;
-            return;
-        }
-
-    state = nextState;
-}
-
-bool SerialAuthentication::readingUser(uint8_t byte, State nextState)
-{
-    bool done = setUsernameByte(byte);
-    if(!done)
-        return false;
-
-    // These states shouldn't have a repeated username.
-    switch(operation)
-    {
-        case Operation::ModifyOwnUsername:
-        case Operation::ModifyUsername:
-        case Operation::CreateUser:
-            if(authentication->getUserManager()->getUser(currentUsername.data()))
-                error = Error::UsernameAlreadyExists;
-            break;
-        default:
-            break;
-    }
-
-    state = nextState;
-    return true;
-}
-
-bool SerialAuthentication::readingPassword(uint8_t byte, State nextState)
-{
-    bool done = setPasswordByte(byte);
-    if(!done)
-        return false;
-
-    state = nextState;
-    return true;
-}
-
-bool SerialAuthentication::readingPassword2(uint8_t byte, State nextState)
-{
-    bool done = setPassword2Byte(byte);
-    if(!done)
-        return false;
-
-    state = nextState;
-    return true;
-}
-
-bool SerialAuthentication::readingName(uint8_t byte, State nextState)
-{
-    bool done = setNameByte(byte);
-    if(!done)
-        return false;
-
-    state = nextState;
-    return true;
-}
-
-bool SerialAuthentication::readingUserId(uint8_t byte, State nextState)
-{
-    bool done = setIdByte(byte);
-    if(!done)
-        return false;
-
-    state = nextState;
-    return true;
-}
-
-bool SerialAuthentication::readingPermission(uint8_t byte, State nextState)
-{
-    bool done = setPermissionByte(byte);
-    if(!done)
-        return false;
-
-    switch(currentPermissionId)
-    {
-        case 0:
-            currentPermission = Permission::None;
-            break;
-        case 1:
-            currentPermission = Permission::Observer;
-            break;
-        case 2:
-            currentPermission = Permission::Maintenance;
-            break;
-        case 3:
-            currentPermission = Permission::Superuser;
-            break;
-        default:
-            error = Error::PermissionIdInvalid;
-            break;
-    }
-
-    state = nextState;
-    return true;
-}
-
-void SerialAuthentication::logOut(uint8_t byte)
-{
-    switch(state)
-    {
-        case State::ReadingToken:
-            if(!setTokenByte(byte))
-                break;
-
-            try
-            {
-                authentication->logOut(currentToken);
-            }
-            catch(...)
+            auto session = authentication->validate(currentToken);
+            if(!session)
             {
                 error = Error::TokenInvalid;
+                break;
             }
 
-            state = State::SendingErrorCode;
-            break;
+            // Don't check if no permission is needed
+            Permission permissionNeeded = getLayout().permissionNeeded;
+            if(permissionNeeded != Permission::None)
+                if(!(*session)->getUser()->hasPermission(permissionNeeded))
+                {
+                    error = Error::UserNoPermission;
+                    break;
+                }
 
-        default:
+            if(getLayout().reservesUser)
+                reserveUser();
             break;
-    }
-}
+        }
 
-void SerialAuthentication::logIn(uint8_t byte)
-{
-    switch(state)
-    {
-        case State::ReadingUser:
-            readingUser(byte, State::ReadingPassword);
+        case Field::NewUsername:
+            if(authentication->getUserManager()->getUser(getString(Field::NewUsername)))
+                error = Error::UsernameAlreadyExists;
             break;
 
-        case State::ReadingPassword:
-            if(!readingPassword(byte, State::SendingToken))
-                break;
+        case Field::UserId:
+            if(!authentication->getUserManager()->getUser(currentId))
+                error = Error::UserIdDoesNotExist;
+            break;
 
-            try
+        case Field::Permission:
+            switch(currentPermissionId)
             {
-                const Session* session = authentication->authenticate(currentUsername.data(), currentPassword.data());
-                currentToken = session->getToken();
-            }
-            catch(...)
-            {
-                error = Error::AuthenticationError;
+                case 0:
+                    currentPermission = Permission::None;
+                    break;
+                case 1:
+                    currentPermission = Permission::Observer;
+                    break;
+                case 2:
+                    currentPermission = Permission::Maintenance;
+                    break;
+                case 3:
+                    currentPermission = Permission::Superuser;
+                    break;
+                default:
+                    error = Error::PermissionIdInvalid;
+                    break;
             }
             break;
 
@@ -169,290 +63,134 @@ void SerialAuthentication::logIn(uint8_t byte)
     }
 }
 
-void SerialAuthentication::createUser(uint8_t byte)
+SerialAuthentication::Error SerialAuthentication::convertError(AuthenticationError authenticationError)
 {
-    switch(state)
+    switch(authenticationError)
     {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUser, Permission::Superuser);
-            break;
+        case AuthenticationError::UserIdNotFound:
+            return Error::UserIdDoesNotExist;
 
-        case State::ReadingUser:
-            readingUser(byte, State::ReadingPassword);
-            break;
+        // The master isn't told whether the username or the password was wrong.
+        case AuthenticationError::UsernameNotFound:
+        case AuthenticationError::IncorrectPassword:
+            return Error::AuthenticationError;
 
-        case State::ReadingPassword:
-            readingPassword(byte, State::ReadingPermission);
-            break;
+        case AuthenticationError::UsernameAlreadyExists:
+            return Error::UsernameAlreadyExists;
 
-        case State::ReadingPermission:
-            if(!readingPermission(byte, State::SendingId))
-                break;
+        case AuthenticationError::InvalidToken:
+            return Error::TokenInvalid;
 
-            try
-            {
-                currentId = authentication->createUser(currentToken, currentPermission, currentUsername.data(), currentPassword.data(), "");
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
+        case AuthenticationError::InsufficientPermissions:
+            return Error::UserNoPermission;
 
-        default:
-            break;
-    }
+        case AuthenticationError::UsernameBufferOverflow:
+            return Error::UsernameOverflow;
 
-}
+        case AuthenticationError::PasswordBufferOverflow:
+            return Error::PasswordOverflow;
 
-void SerialAuthentication::deleteUser(uint8_t byte)
-{
-    switch(state)
-    {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUserId, Permission::Superuser);
-            break;
-
-        case State::ReadingUserId:
-            if(!readingUserId(byte, State::None))
-                break;
+        case AuthenticationError::NameBufferOverflow:
+            return Error::NameOverflow;
 
-            try
-            {
-                authentication->deleteUser(currentToken, currentId);
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
+        case AuthenticationError::Throttled:
+            return Error::Throttled;
 
         default:
-            break;
+            return Error::InternalError;
     }
 }
 
-void SerialAuthentication::modifyOwnUsername(uint8_t byte)
+void SerialAuthentication::logIn()
 {
-    switch(state)
+    auto session = authentication->authenticate(getString(Field::Username), getString(Field::Password), channel);
+    if(!session)
     {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUser);
-            break;
-
-        case State::ReadingUser:
-            if(!readingUser(byte, State::None))
-                break;
-
-            try
-            {
-                authentication->modifyOwnUsername(currentToken, currentUsername.data());
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
-
-        default:
-            break;
+        error = convertError(session.error());
+        return;
     }
+
+    currentToken = (*session)->getToken();
 }
 
-void SerialAuthentication::modifyOwnPassword(uint8_t byte)
+void SerialAuthentication::createUser()
 {
-    switch(state)
+    if(!reservedUser)
     {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingPassword);
-            break;
-
-        case State::ReadingPassword:
-            readingPassword(byte, State::ReadingPassword2);
-            break;
-
-        case State::ReadingPassword2:
-            if(!readingPassword2(byte, State::None))
-                break;
-
-            try
-            {
-                authentication->modifyOwnPassword(currentToken, currentPassword.data(), currentPassword2.data());
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
-
-        default:
-            break;
+        error = Error::InternalError;
+        return;
     }
-}
 
-void SerialAuthentication::modifyOwnName(uint8_t byte)
-{
-    switch(state)
+    auto id = authentication->createUser(currentToken, currentPermission, *reservedUser, currentUsernameLength, currentPasswordLength, 0);
+    releaseReservedUser();
+    if(!id)
     {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingName);
-            break;
-
-        case State::ReadingName:
-            if(!readingName(byte, State::None))
-                break;
-
-            try
-            {
-                authentication->modifyOwnName(currentToken, currentName.data());
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
-
-        default:
-            break;
+        error = convertError(id.error());
+        return;
     }
+
+    currentId = *id;
 }
 
-void SerialAuthentication::modifyUsername(uint8_t byte)
+void SerialAuthentication::logOut()
 {
-    switch(state)
-    {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUserId, Permission::Superuser);
-            break;
-
-        case State::ReadingUserId:
-            if(!readingUserId(byte, State::ReadingUser))
-                break;
-
-            if(!authentication->getUserManager()->getUser(currentId))
-                error = Error::UserIdDoesNotExist;
-            break;
-
-        case State::ReadingUser:
-            if(!readingUser(byte, State::None))
-                break;
-
-            try
-            {
-                authentication->modifyUsername(currentToken, currentId, currentUsername.data());
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
-
-        default:
-            break;
-    }
+    auto result = authentication->logOut(currentToken);
+    if(!result)
+        error = convertError(result.error());
 }
 
-void SerialAuthentication::modifyPassword(uint8_t byte)
+void SerialAuthentication::deleteUser()
 {
-    switch(state)
-    {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUserId, Permission::Superuser);
-            break;
-
-        case State::ReadingUserId:
-            if(!readingUserId(byte, State::ReadingPassword))
-                break;
-
-            if(!authentication->getUserManager()->getUser(currentId))
-                error = Error::UserIdDoesNotExist;
-            break;
-
-        case State::ReadingPassword:
-            if(!readingPassword(byte, State::None))
-                break;
-
-            try
-            {
-                authentication->modifyPassword(currentToken, currentId, currentPassword.data());
-            }
-            catch(...)
-            {
-                error = Error::InternalError;
-            }
-            break;
-
-        default:
-            break;
-    }
+    auto result = authentication->deleteUser(currentToken, currentId);
+    if(!result)
+        error = convertError(result.error());
 }
 
-void SerialAuthentication::modifyName(uint8_t byte)
+void SerialAuthentication::modifyOwnUsername()
 {
-    switch(state)
-    {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUserId, Permission::Superuser);
-            break;
-
-        case State::ReadingUserId:
-            if(!readingUserId(byte, State::ReadingName))
-                break;
-
-            if(!authentication->getUserManager()->getUser(currentId))
-                error = Error::UserIdDoesNotExist;
-            break;
-
-        case State::ReadingName:
-            if(!readingName(byte, State::None))
-                break;
-
-            try
-            {
-                authentication->modifyName(currentToken, currentId, currentName.data());
-            }
-            catch(const std::exception& e)
-            {
-                error = Error::InternalError;
-            }
-            break;
-
-        default:
-            break;
-    }
+    auto result = authentication->modifyOwnUsername(currentToken, getString(Field::NewUsername));
+    if(!result)
+        error = convertError(result.error());
 }
 
-void SerialAuthentication::modifyPermission(uint8_t byte)
+void SerialAuthentication::modifyOwnPassword()
 {
-    switch(state)
-    {
-        case State::ReadingToken:
-            readingToken(byte, State::ReadingUserId, Permission::Superuser);
-            break;
+    auto result = authentication->modifyOwnPassword(currentToken, getString(Field::Password), getString(Field::Password2));
+    if(!result)
+        error = convertError(result.error());
+}
 
-        case State::ReadingUserId:
-            if(!readingUserId(byte, State::ReadingPermission))
-                break;
+void SerialAuthentication::modifyOwnName()
+{
+    auto result = authentication->modifyOwnName(currentToken, getString(Field::Name));
+    if(!result)
+        error = convertError(result.error());
+}
 
-            if(!authentication->getUserManager()->getUser(currentId))
-                error = Error::UserIdDoesNotExist;
-            break;
+void SerialAuthentication::modifyUsername()
+{
+    auto result = authentication->modifyUsername(currentToken, currentId, getString(Field::NewUsername));
+    if(!result)
+        error = convertError(result.error());
+}
 
-        case State::ReadingPermission:
-            if(!readingPermission(byte, State::None))
-                break;
+void SerialAuthentication::modifyPassword()
+{
+    auto result = authentication->modifyPassword(currentToken, currentId, getString(Field::Password));
+    if(!result)
+        error = convertError(result.error());
+}
 
-            try
-            {
-                authentication->modifyPermission(currentToken, currentId, currentPermission);
-            }
-            catch(const std::exception& e)
-            {
-                error = Error::InternalError;
-            }
-            break;
+void SerialAuthentication::modifyName()
+{
+    auto result = authentication->modifyName(currentToken, currentId, getString(Field::Name));
+    if(!result)
+        error = convertError(result.error());
+}
 
-        default:
-            break;
-    }
-}
\ No newline at end of file
+void SerialAuthentication::modifyPermission()
+{
+    auto result = authentication->modifyPermission(currentToken, currentId, currentPermission);
+    if(!result)
+        error = convertError(result.error());
+}
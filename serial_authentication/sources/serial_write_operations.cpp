@@ -1,37 +1,10 @@
 #include "serial_authentication.hpp"
 
-uint8_t SerialAuthentication::logIn()
+uint8_t SerialAuthentication::getFieldByte(Field field)
 {
-    uint8_t byte = 0;
-    switch(state)
-    {
-        case State::SendingToken:
-            if(!getTokenByte(&byte))
-                break;
-            state = State::SendingErrorCode;
-            break;
+    auto integer = getIntegerField(field);
+    if(currentByteIndex >= integer.size())
+        return 0;
 
-        default:
-            break;
-    }
-
-    return byte;
+    return integer[currentByteIndex++];
 }
-
-uint8_t SerialAuthentication::createUser()
-{
-    uint8_t byte = 0;
-    switch(state)
-    {
-        case State::SendingId:
-            if(!getIdByte(&byte))
-                break;
-            state = State::SendingErrorCode;
-            break;
-
-        default:
-            break;
-    }
-
-    return byte;
-}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+
+#include <termios.h>
+
+#include "serial_authentication_static.hpp"
+
+// Exposes SerialAuthentication over file descriptors: serial ttys, pseudo-terminals
+// and Unix domain sockets. Every request is the operation code followed by the
+// request fields, and is answered with the response bytes and the error code.
+// Idle and unknown operation codes are answered with the InvalidOperation error code.
+class SerialServer
+{
+    public:
+        static constexpr size_t MaxConnections = 64;
+        static constexpr size_t BuffersSize = 64;
+
+        SerialServer(Authentication& authentication);
+        ~SerialServer();
+
+        SerialServer(const SerialServer&) = delete;
+        SerialServer& operator=(const SerialServer&) = delete;
+
+        bool addTerminal(const char* path, speed_t baudRate);
+
+        // Returns the path of the slave side, which is what clients open.
+        std::optional<std::string> addPseudoTerminal();
+
+        bool listenUnix(const char* path);
+
+        // Serves every descriptor until SIGINT or SIGTERM is received.
+        bool run();
+
+    protected:
+        enum class Kind
+        {
+            Free,
+            Stream,
+            Listener,
+            Signals,
+        };
+
+        // Largest response per request byte: LogIn takes three bytes
+        // and answers with the token and the error code.
+        static constexpr size_t MaxResponseRatio = 3;
+        static constexpr size_t MaxResponseSize = sizeof(Session::TokenType) + 1;
+
+        struct Connection
+        {
+            Kind kind = Kind::Free;
+            int fd = -1;
+
+            // Pseudo-terminals keep the slave open so the master doesn't hang up when clients leave.
+            int slaveFd = -1;
+
+            std::optional<SerialAuthenticationStatic<BuffersSize>> parser;
+            bool awaitingOperation = true;
+
+            std::array<uint8_t, 1024> transmit;
+            size_t transmitHead = 0;
+            size_t transmitSize = 0;
+            bool waitingWritable = false;
+        };
+
+        Authentication* authentication;
+        int epollFd = -1;
+        std::string listenerPath;
+
+        std::array<Connection, MaxConnections> connections;
+
+        Connection* addDescriptor(int fd, Kind kind);
+        void closeConnection(Connection& connection);
+        void updateEvents(Connection& connection, bool writable);
+
+        void accept(Connection& listener);
+        void receive(Connection& connection);
+        void flush(Connection& connection);
+
+        void handle(Connection& connection, std::span<const uint8_t> bytes);
+        size_t getTransmitFree(const Connection& connection) const;
+        void queueTransmit(Connection& connection, std::span<const uint8_t> bytes);
+};
@@ -0,0 +1,163 @@
+#include "serial_server.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+static constexpr size_t UsersAmount = 256;
+static constexpr size_t SessionsAmount = 256;
+
+static StaticUserManager<UsersAmount, 32, 64, 64> userManager;
+static Clock serverClock;
+static StaticSessionManager<SessionsAmount> sessionManager(serverClock);
+static Authentication authentication(userManager, sessionManager);
+
+static constexpr const char* PasswordVariable = "SERIAL_SERVER_PASSWORD";
+
+static void printUsage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s --user NAME [--tty PATH[:BAUD]]... [--pty]... [--unix PATH]\n"
+        "  --user  Superuser created at startup, needed to administer the other users.\n"
+        "  --tty   Serial terminal to serve, 115200 baud by default.\n"
+        "  --pty   Pseudo-terminal to serve, the path clients open is printed.\n"
+        "  --unix  Unix domain socket to accept connections on.\n"
+        "The password of the superuser is taken from the %s environment variable\n"
+        "or else from the first line of the standard input.\n",
+        program, PasswordVariable);
+}
+
+// Kept out of the arguments, which any user of the system can read while the server runs.
+static bool readPassword(std::array<char, 256>& buffer, std::string_view& password)
+{
+    if(const char* variable = std::getenv(PasswordVariable))
+    {
+        password = variable;
+        return !password.empty();
+    }
+
+    if(!std::fgets(buffer.data(), buffer.size(), stdin))
+        return false;
+
+    password = buffer.data();
+    if(!password.empty() && password.back() == '\n')
+        password.remove_suffix(1);
+    if(!password.empty() && password.back() == '\r')
+        password.remove_suffix(1);
+
+    return !password.empty();
+}
+
+static speed_t getBaudRate(unsigned long baudRate)
+{
+    switch(baudRate)
+    {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B0;
+    }
+}
+
+static bool addTerminal(SerialServer& server, std::string_view argument)
+{
+    std::string path(argument);
+    unsigned long baudRate = 115200;
+
+    auto separator = argument.rfind(':');
+    if(separator != std::string_view::npos)
+    {
+        path = argument.substr(0, separator);
+        baudRate = std::strtoul(std::string(argument.substr(separator + 1)).c_str(), nullptr, 10);
+    }
+
+    speed_t speed = getBaudRate(baudRate);
+    if(speed == B0)
+    {
+        std::fprintf(stderr, "Unsupported baud rate %lu.\n", baudRate);
+        return false;
+    }
+
+    return server.addTerminal(path.c_str(), speed);
+}
+
+static bool addUser(std::string_view username)
+{
+    std::array<char, 256> buffer;
+    std::string_view password;
+    if(!readPassword(buffer, password))
+    {
+        std::fprintf(stderr, "No password for user %.*s in %s or on the standard input.\n",
+                     static_cast<int>(username.size()), username.data(), PasswordVariable);
+        return false;
+    }
+
+    auto user = userManager.createUser(Permission::Superuser, username, password);
+    if(!user)
+    {
+        std::fprintf(stderr, "Could not create user %.*s.\n", static_cast<int>(username.size()), username.data());
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    SerialServer server(authentication);
+    const char* username = nullptr;
+    bool hasEndpoint = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string_view option = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if(option == "--user" && hasValue && !username)
+            username = argv[++i];
+        else if(option == "--tty" && hasValue)
+        {
+            if(!addTerminal(server, argv[++i]))
+                return EXIT_FAILURE;
+            hasEndpoint = true;
+        }
+        else if(option == "--pty")
+        {
+            auto path = server.addPseudoTerminal();
+            if(!path)
+                return EXIT_FAILURE;
+            std::printf("%s\n", path->c_str());
+            hasEndpoint = true;
+        }
+        else if(option == "--unix" && hasValue)
+        {
+            if(!server.listenUnix(argv[++i]))
+                return EXIT_FAILURE;
+            hasEndpoint = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(!username || !hasEndpoint)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(!addUser(username))
+        return EXIT_FAILURE;
+
+    std::fflush(stdout);
+    return server.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
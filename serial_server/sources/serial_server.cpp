@@ -0,0 +1,393 @@
+#include "serial_server.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+SerialServer::SerialServer(Authentication& authentication)
+    : authentication(&authentication)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd < 0)
+        std::perror("epoll_create1");
+}
+
+SerialServer::~SerialServer()
+{
+    for(auto& connection : connections)
+        closeConnection(connection);
+
+    if(!listenerPath.empty())
+        unlink(listenerPath.c_str());
+
+    if(epollFd >= 0)
+        close(epollFd);
+}
+
+bool SerialServer::addTerminal(const char* path, speed_t baudRate)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(fd < 0)
+    {
+        std::perror(path);
+        return false;
+    }
+
+    termios settings;
+    if(tcgetattr(fd, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        cfsetispeed(&settings, baudRate);
+        cfsetospeed(&settings, baudRate);
+        settings.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &settings);
+    }
+
+    if(!addDescriptor(fd, Kind::Stream))
+    {
+        close(fd);
+        return false;
+    }
+
+    return true;
+}
+
+std::optional<std::string> SerialServer::addPseudoTerminal()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+    {
+        std::perror("posix_openpt");
+        if(fd >= 0)
+            close(fd);
+        return std::nullopt;
+    }
+
+    std::string slavePath = ptsname(fd);
+
+    // Raw mode on the slave, the protocol is binary.
+    int slaveFd = open(slavePath.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    termios settings;
+    if(slaveFd >= 0 && tcgetattr(slaveFd, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        tcsetattr(slaveFd, TCSANOW, &settings);
+    }
+
+    Connection* connection = addDescriptor(fd, Kind::Stream);
+    if(!connection)
+    {
+        close(fd);
+        if(slaveFd >= 0)
+            close(slaveFd);
+        return std::nullopt;
+    }
+
+    connection->slaveFd = slaveFd;
+    return slavePath;
+}
+
+bool SerialServer::listenUnix(const char* path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if(std::strlen(path) >= sizeof(address.sun_path))
+    {
+        std::fprintf(stderr, "%s: socket path too long\n", path);
+        return false;
+    }
+    std::strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        std::perror("socket");
+        return false;
+    }
+
+    unlink(path);
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        std::perror(path);
+        close(fd);
+        return false;
+    }
+
+    if(!addDescriptor(fd, Kind::Listener))
+    {
+        close(fd);
+        return false;
+    }
+
+    listenerPath = path;
+    return true;
+}
+
+bool SerialServer::run()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(signalFd < 0 || !addDescriptor(signalFd, Kind::Signals))
+    {
+        std::perror("signalfd");
+        return false;
+    }
+
+    std::array<epoll_event, 32> events;
+    while(true)
+    {
+        int ready = epoll_wait(epollFd, events.data(), events.size(), -1);
+        if(ready < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            std::perror("epoll_wait");
+            return false;
+        }
+
+        for(int i = 0; i < ready; i++)
+        {
+            Connection& connection = connections[events[i].data.u32];
+            uint32_t flags = events[i].events;
+
+            switch(connection.kind)
+            {
+                case Kind::Signals:
+                    return true;
+
+                case Kind::Listener:
+                    accept(connection);
+                    break;
+
+                case Kind::Stream:
+                    if(flags & EPOLLOUT)
+                        flush(connection);
+                    if(flags & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                        receive(connection);
+                    break;
+
+                case Kind::Free:
+                    break;
+            }
+        }
+    }
+}
+
+SerialServer::Connection* SerialServer::addDescriptor(int fd, Kind kind)
+{
+    auto isFree = [](const Connection& connection) {return connection.kind == Kind::Free;};
+    auto it = std::find_if(connections.begin(), connections.end(), isFree);
+    if(it == connections.end())
+    {
+        std::fprintf(stderr, "Too many connections, at most %zu are served.\n", MaxConnections);
+        return nullptr;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u32 = it - connections.begin();
+    if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        std::perror("epoll_ctl");
+        return nullptr;
+    }
+
+    it->kind = kind;
+    it->fd = fd;
+    it->slaveFd = -1;
+    it->awaitingOperation = true;
+    it->transmitHead = 0;
+    it->transmitSize = 0;
+    it->waitingWritable = false;
+    if(kind == Kind::Stream)
+    {
+        it->parser.emplace(*authentication);
+        it->parser->setChannel(it - connections.begin());
+    }
+
+    return &*it;
+}
+
+void SerialServer::closeConnection(Connection& connection)
+{
+    if(connection.kind == Kind::Free)
+        return;
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    close(connection.fd);
+    if(connection.slaveFd >= 0)
+        close(connection.slaveFd);
+
+    connection.kind = Kind::Free;
+    connection.fd = -1;
+    connection.slaveFd = -1;
+    connection.parser.reset();
+}
+
+void SerialServer::updateEvents(Connection& connection, bool writable)
+{
+    if(connection.waitingWritable == writable)
+        return;
+
+    // While the response can't be written no more requests are read.
+    epoll_event event{};
+    event.events = writable ? EPOLLOUT : EPOLLIN;
+    event.data.u32 = &connection - connections.data();
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.waitingWritable = writable;
+}
+
+void SerialServer::accept(Connection& listener)
+{
+    while(true)
+    {
+        int fd = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                std::perror("accept4");
+            return;
+        }
+
+        if(!addDescriptor(fd, Kind::Stream))
+            close(fd);
+    }
+}
+
+void SerialServer::receive(Connection& connection)
+{
+    std::array<uint8_t, 256> chunk;
+
+    while(connection.kind == Kind::Stream && !connection.waitingWritable)
+    {
+        // Only read what can be answered without overflowing the transmit buffer,
+        // including a request started in a previous chunk.
+        size_t transmitFree = getTransmitFree(connection);
+        size_t capacity = 0;
+        if(transmitFree > MaxResponseSize)
+            capacity = std::min(chunk.size(), (transmitFree - MaxResponseSize) / MaxResponseRatio);
+
+        if(capacity == 0)
+        {
+            updateEvents(connection, true);
+            return;
+        }
+
+        ssize_t received = read(connection.fd, chunk.data(), capacity);
+        if(received < 0 && errno == EINTR)
+            continue;
+
+        if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+
+        // A pseudo-terminal reports EIO while no client has the slave open.
+        if(received < 0 && errno == EIO && connection.slaveFd >= 0)
+            return;
+
+        if(received <= 0)
+        {
+            closeConnection(connection);
+            return;
+        }
+
+        handle(connection, std::span(chunk.data(), received));
+        flush(connection);
+    }
+}
+
+void SerialServer::flush(Connection& connection)
+{
+    while(connection.kind == Kind::Stream && connection.transmitSize > 0)
+    {
+        // The pending bytes wrap around the end of the buffer at most once.
+        size_t firstLength = std::min(connection.transmitSize, connection.transmit.size() - connection.transmitHead);
+        std::array<iovec, 2> vectors
+        {{
+            {connection.transmit.data() + connection.transmitHead, firstLength},
+            {connection.transmit.data(), connection.transmitSize - firstLength},
+        }};
+
+        ssize_t written = writev(connection.fd, vectors.data(), vectors[1].iov_len ? 2 : 1);
+        if(written < 0 && errno == EINTR)
+            continue;
+
+        if(written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            updateEvents(connection, true);
+            return;
+        }
+
+        if(written < 0)
+        {
+            closeConnection(connection);
+            return;
+        }
+
+        connection.transmitHead = (connection.transmitHead + written) % connection.transmit.size();
+        connection.transmitSize -= written;
+    }
+
+    if(connection.kind == Kind::Stream)
+        updateEvents(connection, false);
+}
+
+void SerialServer::handle(Connection& connection, std::span<const uint8_t> bytes)
+{
+    SerialAuthentication& parser = *connection.parser;
+    size_t offset = 0;
+
+    while(offset < bytes.size())
+    {
+        if(connection.awaitingOperation)
+        {
+            parser.setOperation(static_cast<SerialAuthentication::Operation>(bytes[offset++]));
+            connection.awaitingOperation = !parser.isReading();
+
+            // Idle and unknown operations have no request, without an answer the master would wait forever.
+            if(connection.awaitingOperation)
+            {
+                uint8_t errorCode = SerialAuthentication::getInvalidOperationCode();
+                queueTransmit(connection, std::span(&errorCode, 1));
+            }
+            continue;
+        }
+
+        offset += parser.authenticateBytes(bytes.subspan(offset));
+        if(parser.isReading())
+            break;
+
+        std::array<uint8_t, MaxResponseSize> response;
+        queueTransmit(connection, std::span(response.data(), parser.getNextBytes(response)));
+        connection.awaitingOperation = true;
+    }
+}
+
+size_t SerialServer::getTransmitFree(const Connection& connection) const
+{
+    return connection.transmit.size() - connection.transmitSize;
+}
+
+void SerialServer::queueTransmit(Connection& connection, std::span<const uint8_t> bytes)
+{
+    for(uint8_t byte : bytes)
+    {
+        size_t tail = (connection.transmitHead + connection.transmitSize) % connection.transmit.size();
+        connection.transmit[tail] = byte;
+        connection.transmitSize++;
+    }
+}
@@ -0,0 +1,378 @@
+#include "authentication.hpp"
+#include "login_throttle.hpp"
+#include "serial_authentication_static.hpp"
+#include "serial_authentication_coroutine.hpp"
+#include "serial_authentication_framed.hpp"
+#include "serial_authentication_hub.hpp"
+#include "crc.hpp"
+
+#include <new>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Runs every Authentication entry point and every serial operation, through each
+// parser variant, and fails if any of them allocates from the heap. malloc, calloc,
+// realloc and operator new are all interposed, so allocations made by the C or C++
+// runtimes on behalf of the libraries are caught too.
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t amount, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* pointer);
+}
+
+static bool counting = false;
+static size_t allocations = 0;
+
+static void countAllocation()
+{
+    if(counting)
+        allocations++;
+}
+
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        countAllocation();
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t amount, size_t size)
+    {
+        countAllocation();
+        return __libc_calloc(amount, size);
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        countAllocation();
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void* pointer)
+    {
+        __libc_free(pointer);
+    }
+}
+
+static void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+{
+    countAllocation();
+    void* pointer = alignment > alignof(std::max_align_t) ? __libc_memalign(alignment, size ? size : 1) : __libc_malloc(size ? size : 1);
+    // The libraries may be built without exceptions.
+    if(!pointer)
+        std::abort();
+    return pointer;
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* pointer) noexcept { __libc_free(pointer); }
+void operator delete[](void* pointer) noexcept { __libc_free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { __libc_free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { __libc_free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { __libc_free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { __libc_free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { __libc_free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { __libc_free(pointer); }
+
+static size_t failures = 0;
+
+static void expect(bool condition, const char* scope, const char* what)
+{
+    if(condition)
+        return;
+
+    std::fprintf(stderr, "%s: %s\n", scope, what);
+    failures++;
+}
+
+// Runs the function counting the allocations made meanwhile, which must be none.
+template <typename Function>
+static auto measure(const char* scope, const char* operation, Function function)
+{
+    allocations = 0;
+    counting = true;
+    auto result = function();
+    counting = false;
+
+    if(allocations > 0)
+    {
+        std::fprintf(stderr, "%s: %s allocated %zu times\n", scope, operation, allocations);
+        failures++;
+    }
+
+    return result;
+}
+
+template <typename Function>
+static void expectSuccess(const char* scope, const char* operation, Function function)
+{
+    expect(measure(scope, operation, function).has_value(), scope, operation);
+}
+
+static void runAuthentication()
+{
+    const char* scope = "Authentication";
+
+    Clock clock;
+    StaticUserManager<16, 16, 16, 16> userManager;
+    StaticSessionManager<8> sessionManager(clock);
+    StaticLoginThrottle<8> throttle(clock);
+    Authentication authentication(userManager, sessionManager);
+    authentication.setLoginThrottle(throttle);
+
+    expect(userManager.createUser(Permission::Superuser, "root", "rootpass").has_value(), scope, "the superuser wasn't created");
+
+    auto root = measure(scope, "authenticate", [&]() {return authentication.authenticate("root", "rootpass", 1);});
+    expect(root.has_value(), scope, "authenticate failed");
+    if(!root)
+        return;
+    Session::TokenType token = (*root)->getToken();
+
+    auto failed = measure(scope, "authenticate with a wrong password", [&]() {return authentication.authenticate("root", "wrongpass", 1);});
+    expect(!failed.has_value(), scope, "a wrong password was accepted");
+
+    expectSuccess(scope, "validate", [&]() {return authentication.validate(token);});
+    expectSuccess(scope, "validateWithPermission", [&]() {return authentication.validateWithPermission(token, Permission::Maintenance);});
+    measure(scope, "updateSessions", [&]() {authentication.updateSessions(); return 0;});
+
+    auto id = measure(scope, "createUser", [&]() {return authentication.createUser(token, Permission::Observer, "observer", "password", "Observer");});
+    expect(id.has_value(), scope, "createUser failed");
+
+    std::array<UserSpec, 2> specs{{
+        {Permission::Observer, "first", "password", "First"},
+        {Permission::Observer, "second", "password", "Second"},
+    }};
+    std::array<ResultUser, 2> results;
+    auto created = measure(scope, "createUsers", [&]() {return authentication.createUsers(token, specs, results);});
+    expect(created && *created == specs.size(), scope, "createUsers failed");
+
+    if(id)
+    {
+        expectSuccess(scope, "modifyUsername", [&]() {return authentication.modifyUsername(token, *id, "renamed");});
+        expectSuccess(scope, "modifyPassword", [&]() {return authentication.modifyPassword(token, *id, "newpassword");});
+        expectSuccess(scope, "modifyName", [&]() {return authentication.modifyName(token, *id, "Renamed");});
+        expectSuccess(scope, "modifyPermission", [&]() {return authentication.modifyPermission(token, *id, Permission::Maintenance);});
+        UserPatch patch{.name = "Patched", .permission = Permission::Observer};
+        expectSuccess(scope, "modifyUser", [&]() {return authentication.modifyUser(token, *id, patch);});
+    }
+
+    auto user = measure(scope, "authenticate as a new user", [&]() {return authentication.authenticate("renamed", "newpassword");});
+    expect(user.has_value(), scope, "the new user couldn't log in");
+    if(user)
+    {
+        Session::TokenType userToken = (*user)->getToken();
+        expectSuccess(scope, "modifyOwnUsername", [&]() {return authentication.modifyOwnUsername(userToken, "own");});
+        expectSuccess(scope, "modifyOwnPassword", [&]() {return authentication.modifyOwnPassword(userToken, "newpassword", "ownpassword");});
+        expectSuccess(scope, "modifyOwnName", [&]() {return authentication.modifyOwnName(userToken, "Own");});
+        UserPatch patch{.name = "Own patched"};
+        expectSuccess(scope, "modifyOwnUser", [&]() {return authentication.modifyOwnUser(userToken, patch);});
+        expectSuccess(scope, "logOut", [&]() {return authentication.logOut(userToken);});
+    }
+
+    if(id)
+        expectSuccess(scope, "deleteUser", [&]() {return authentication.deleteUser(token, *id);});
+}
+
+// Request fields in the wire format: strings null terminated, integers little endian.
+struct Request
+{
+    std::array<uint8_t, 128> bytes;
+    size_t length = 0;
+
+    Request& add(std::string_view string)
+    {
+        std::memcpy(bytes.data() + length, string.data(), string.size());
+        length += string.size();
+        bytes[length++] = '\0';
+        return *this;
+    }
+
+    template <typename Integer> requires std::is_integral_v<Integer>
+    Request& add(Integer value)
+    {
+        std::memcpy(bytes.data() + length, &value, sizeof(value));
+        length += sizeof(value);
+        return *this;
+    }
+
+    std::span<const uint8_t> get() const
+    {
+        return std::span(bytes).first(length);
+    }
+};
+
+using Operation = SerialAuthentication::Operation;
+
+// Sends the operation and request of the unframed protocol, returns the response and error code.
+struct StreamTransport
+{
+    SerialAuthentication& parser;
+    std::array<uint8_t, 16> response;
+
+    std::span<const uint8_t> exchange(Operation operation, const Request& request, size_t)
+    {
+        parser.setOperation(operation);
+        parser.authenticateBytes(request.get());
+        return std::span(response).first(parser.getNextBytes(response));
+    }
+};
+
+struct FramedTransport
+{
+    FramedSerialAuthentication& parser;
+    std::array<uint8_t, 160> frame;
+    std::array<uint8_t, 32> response;
+    uint8_t id = 0;
+
+    std::span<const uint8_t> exchange(Operation operation, const Request& request, size_t)
+    {
+        size_t length = request.length;
+        frame[0] = FramedSerialAuthentication::Start;
+        frame[1] = id++;
+        frame[2] = std::to_underlying(operation);
+        frame[3] = length & 0xFF;
+        frame[4] = length >> 8;
+        std::memcpy(frame.data() + FramedSerialAuthentication::HeaderSize, request.bytes.data(), length);
+
+        size_t crcOffset = FramedSerialAuthentication::HeaderSize + length;
+        uint16_t crc = Crc16::compute(std::span<const uint8_t>(frame).subspan(1, crcOffset - 1));
+        frame[crcOffset] = crc & 0xFF;
+        frame[crcOffset + 1] = crc >> 8;
+
+        parser.authenticateBytes(std::span(frame).first(crcOffset + FramedSerialAuthentication::CrcSize));
+        size_t received = parser.getNextBytes(response);
+        if(received < FramedSerialAuthentication::HeaderSize + FramedSerialAuthentication::CrcSize)
+            return {};
+
+        size_t payloadLength = response[3] | (response[4] << 8);
+        return std::span(response).subspan(FramedSerialAuthentication::HeaderSize, payloadLength);
+    }
+};
+
+struct HubTransport
+{
+    SerialAuthenticationHub& hub;
+    std::array<uint8_t, 16> response;
+
+    std::span<const uint8_t> exchange(Operation operation, const Request& request, size_t responseLength)
+    {
+        hub.setOperation(0, operation);
+        for(uint8_t byte : request.get())
+            hub.receive(0, byte);
+        hub.service(request.length);
+
+        for(size_t index = 0; index < responseLength; index++)
+            response[index] = hub.getNextByte(0);
+        return std::span(response).first(responseLength);
+    }
+};
+
+// Every operation of the serial protocol, each one expected to succeed.
+template <typename Transport>
+static void runSerial(const char* scope, Transport& transport)
+{
+    constexpr size_t TokenResponse = sizeof(Session::TokenType) + 1;
+    constexpr size_t IdResponse = sizeof(User::IdType) + 1;
+    constexpr size_t ErrorResponse = 1;
+
+    Session::TokenType token = 0;
+    User::IdType id = 0;
+    Session::TokenType userToken = 0;
+
+    auto run = [&](const char* name, Operation operation, const Request& request, size_t responseLength, auto* value) {
+        auto response = measure(scope, name, [&]() {return transport.exchange(operation, request, responseLength);});
+
+        bool succeeded = response.size() == responseLength && response.back() == 0;
+        expect(succeeded, scope, name);
+        if constexpr(!std::is_same_v<decltype(value), std::nullptr_t*>)
+        {
+            if(succeeded)
+                std::memcpy(value, response.data(), sizeof(*value));
+        }
+    };
+    std::nullptr_t* none = nullptr;
+
+    run("LogIn", Operation::LogIn, Request().add("root").add("rootpass"), TokenResponse, &token);
+    run("CreateUser", Operation::CreateUser, Request().add(token).add("serial").add("password").add(uint16_t{2}), IdResponse, &id);
+    run("ModifyUsername", Operation::ModifyUsername, Request().add(token).add(id).add("renamed"), ErrorResponse, none);
+    run("ModifyPassword", Operation::ModifyPassword, Request().add(token).add(id).add("newpassword"), ErrorResponse, none);
+    run("ModifyName", Operation::ModifyName, Request().add(token).add(id).add("Renamed"), ErrorResponse, none);
+    run("ModifyPermission", Operation::ModifyPermission, Request().add(token).add(id).add(uint16_t{1}), ErrorResponse, none);
+
+    run("LogIn as the new user", Operation::LogIn, Request().add("renamed").add("newpassword"), TokenResponse, &userToken);
+    run("ModifyOwnUsername", Operation::ModifyOwnUsername, Request().add(userToken).add("own"), ErrorResponse, none);
+    run("ModifyOwnPassword", Operation::ModifyOwnPassword, Request().add(userToken).add("newpassword").add("ownpassword"), ErrorResponse, none);
+    run("ModifyOwnName", Operation::ModifyOwnName, Request().add(userToken).add("Own"), ErrorResponse, none);
+    run("LogOut of the new user", Operation::LogOut, Request().add(userToken), ErrorResponse, none);
+
+    run("DeleteUser", Operation::DeleteUser, Request().add(token).add(id), ErrorResponse, none);
+    run("LogOut", Operation::LogOut, Request().add(token), ErrorResponse, none);
+}
+
+// Each parser gets a table with only the superuser, so every run creates the same users.
+struct SerialFixture
+{
+    Clock clock;
+    StaticUserManager<8, 16, 16, 16> userManager;
+    StaticSessionManager<8> sessionManager{clock};
+    Authentication authentication{userManager, sessionManager};
+
+    SerialFixture()
+    {
+        expect(userManager.createUser(Permission::Superuser, "root", "rootpass").has_value(), "Serial", "the superuser wasn't created");
+    }
+};
+
+int main()
+{
+    runAuthentication();
+
+    {
+        SerialFixture fixture;
+        SerialAuthenticationStatic<16> parser(fixture.authentication);
+        StreamTransport transport{parser, {}};
+        runSerial("SerialAuthentication", transport);
+    }
+
+    {
+        expect(CoroutineSerialAuthentication::getLargestFrameSize() <= CoroutineSerialAuthentication::FrameSize,
+               "CoroutineSerialAuthentication", "a sequence frame is larger than SERIAL_AUTHENTICATION_COROUTINE_FRAME_SIZE");
+
+        SerialFixture fixture;
+        CoroutineSerialAuthenticationStatic<16> parser(fixture.authentication);
+        StreamTransport transport{parser, {}};
+        runSerial("CoroutineSerialAuthentication", transport);
+    }
+
+    {
+        SerialFixture fixture;
+        FramedSerialAuthenticationStatic<16> parser(fixture.authentication);
+        FramedTransport transport{parser, {}, {}};
+        runSerial("FramedSerialAuthentication", transport);
+    }
+
+    {
+        SerialFixture fixture;
+        SerialAuthenticationHubStatic<1, 1, 16, 64> hub(fixture.authentication);
+        HubTransport transport{hub, {}};
+        runSerial("SerialAuthenticationHub", transport);
+    }
+
+    std::printf("%zu failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,234 @@
+#include "journaled_user_manager.hpp"
+#include "journal_storage.hpp"
+#include "user_patch.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Tears each storage of a JournaledUserManager after every possible amount of
+// bytes, simulating a power loss at that point, and checks that reopening the
+// manager recovers the users as they were after one of the mutations: every
+// record is checked on its own, so a torn commit keeps its complete records.
+// The users recovered can't be older than the ones of the last commit whose
+// bytes were all written before the tear.
+
+using Manager = StaticJournaledUserManager<8, 12, 12, 12, 128>;
+
+struct UserState
+{
+    User::IdType id;
+    Permission permission;
+    std::string username;
+    std::string password;
+    std::string name;
+
+    bool operator==(const UserState&) const = default;
+};
+
+using TableState = std::vector<UserState>;
+
+// Bytes appended to each storage once a commit returned, and the state it made durable.
+struct Commit
+{
+    std::array<size_t, 3> appended;
+    size_t state;
+};
+
+struct Script
+{
+    std::vector<TableState> states;
+    std::vector<Commit> commits;
+};
+
+// Memory storage counting every byte appended, to know how far it can be torn.
+// The power is lost when an append goes past the tear point: the bytes before
+// it are kept and every later write to any of the storages is lost, while
+// still reported as done.
+class CountingStorage : public MemoryJournalStorage
+{
+    public:
+        CountingStorage(std::span<uint8_t> bufferStorage, bool& powerLost)
+            : MemoryJournalStorage(bufferStorage), powerLost(powerLost)
+        {}
+
+        ResultVoid append(std::span<const uint8_t> bytes) override
+        {
+            if(powerLost)
+                return {};
+
+            if(bytes.size() > tearPoint - appended)
+            {
+                auto kept = MemoryJournalStorage::append(bytes.first(tearPoint - appended));
+                appended = tearPoint;
+                powerLost = true;
+                return kept;
+            }
+
+            appended += bytes.size();
+            return MemoryJournalStorage::append(bytes);
+        }
+
+        ResultVoid truncate(size_t newSize) override
+        {
+            if(powerLost)
+                return {};
+
+            return MemoryJournalStorage::truncate(newSize);
+        }
+
+        size_t appended = 0;
+        size_t tearPoint = SIZE_MAX;
+
+    private:
+        bool& powerLost;
+};
+
+struct Storages
+{
+    std::vector<uint8_t> snapshotBuffer = std::vector<uint8_t>(4096);
+    std::vector<uint8_t> otherSnapshotBuffer = std::vector<uint8_t>(4096);
+    std::vector<uint8_t> journalBuffer = std::vector<uint8_t>(4096);
+    bool powerLost = false;
+
+    CountingStorage snapshot{snapshotBuffer, powerLost};
+    CountingStorage otherSnapshot{otherSnapshotBuffer, powerLost};
+    CountingStorage journal{journalBuffer, powerLost};
+
+    CountingStorage& get(size_t index)
+    {
+        return index == 0 ? snapshot : index == 1 ? otherSnapshot : journal;
+    }
+};
+
+static TableState getState(const UserManager& userManager)
+{
+    TableState state;
+    for(size_t slot = 0; slot < userManager.getMaxUsers(); slot++)
+    {
+        auto user = userManager.getUserInSlot(slot);
+        if(!user)
+            continue;
+
+        const User& valid = **user;
+        state.push_back({valid.getId(), valid.getPermission(), std::string(valid.getUsername()),
+                         std::string(valid.getPassword()), std::string(valid.getName())});
+    }
+
+    std::sort(state.begin(), state.end(), [](const UserState& a, const UserState& b) {return a.id < b.id;});
+    return state;
+}
+
+// Runs the same mutations every time, returning the state after each one and
+// the commits that succeeded. Errors are ignored: the storages still report
+// their writes as done once the power is lost.
+static Script runScript(Storages& storages)
+{
+    Script script;
+    std::vector<TableState>& states = script.states;
+
+    Manager manager;
+    if(!manager.open(storages.snapshot, storages.otherSnapshot, storages.journal))
+        return script;
+
+    states.push_back(getState(manager));
+    manager.setCompactionThreshold(160);
+
+    auto commit = [&]()
+    {
+        if(manager.commit())
+            script.commits.push_back({{storages.snapshot.appended, storages.otherSnapshot.appended, storages.journal.appended}, states.size() - 1});
+    };
+
+    for(int round = 0; round < 3; round++)
+    {
+        for(int index = 0; index < 3; index++)
+        {
+            std::string username = "user" + std::to_string(round * 3 + index);
+            (void)manager.createUser(Permission::Observer, username, "password", "Name");
+            states.push_back(getState(manager));
+        }
+        commit();
+
+        auto user = manager.getUser("user" + std::to_string(round * 3));
+        if(user)
+        {
+            UserPatch patch{.password = "changed", .permission = Permission::Maintenance};
+            (void)manager.patchUser((*user)->getId(), patch);
+            states.push_back(getState(manager));
+        }
+        (void)manager.deleteUser("user" + std::to_string(round * 3 + 1));
+        states.push_back(getState(manager));
+        commit();
+    }
+
+    return script;
+}
+
+int main()
+{
+    Script expected;
+    std::array<size_t, 3> appended;
+    {
+        Storages storages;
+        expected = runScript(storages);
+        for(size_t target = 0; target < appended.size(); target++)
+            appended[target] = storages.get(target).appended;
+    }
+
+    if(expected.commits.empty())
+    {
+        std::fprintf(stderr, "no commit succeeded without tearing\n");
+        return EXIT_FAILURE;
+    }
+
+    const char* names[] = {"snapshot", "other snapshot", "journal"};
+    size_t failures = 0;
+
+    for(size_t target = 0; target < appended.size(); target++)
+    {
+        for(size_t offset = 0; offset <= appended[target]; offset++)
+        {
+            Storages storages;
+            storages.get(target).tearPoint = offset;
+            runScript(storages);
+
+            // Power comes back: writes work again and the manager is reopened.
+            storages.get(target).tearPoint = SIZE_MAX;
+            storages.powerLost = false;
+            Manager recovered;
+            auto opened = recovered.open(storages.snapshot, storages.otherSnapshot, storages.journal);
+            if(!opened)
+            {
+                std::fprintf(stderr, "%s torn after %zu bytes: open failed with error %d\n", names[target], offset, static_cast<int>(opened.error()));
+                failures++;
+                continue;
+            }
+
+            // The oldest state allowed is the one of the last commit written before the tear.
+            size_t oldest = 0;
+            for(const Commit& commit : expected.commits)
+                if(commit.appended[target] <= offset)
+                    oldest = commit.state;
+
+            auto newer = expected.states.begin() + oldest;
+            auto found = std::find(expected.states.begin(), expected.states.end(), getState(recovered));
+            if(found == expected.states.end())
+            {
+                std::fprintf(stderr, "%s torn after %zu bytes: the users recovered aren't the ones after any mutation\n", names[target], offset);
+                failures++;
+            }
+            else if(std::find(newer, expected.states.end(), *found) == expected.states.end())
+            {
+                std::fprintf(stderr, "%s torn after %zu bytes: the users recovered are older than the last commit written before the tear\n", names[target], offset);
+                failures++;
+            }
+        }
+    }
+
+    std::printf("torn %zu, %zu and %zu bytes of the storages, %zu failures\n", appended[0], appended[1], appended[2], failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
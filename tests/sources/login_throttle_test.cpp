@@ -0,0 +1,76 @@
+#include "authentication.hpp"
+#include "login_throttle.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Fills the table of a LoginThrottle with usernames that keep failing and checks
+// that a valid user without an entry still logs in, that the failures of the
+// usernames that didn't fit are still throttled, and that they only block the
+// usernames without an entry for a while.
+
+class ManualClock : public Clock
+{
+    public:
+        uint32_t getTime() const override
+        {
+            return time;
+        }
+
+        uint32_t time = 1;
+};
+
+static size_t failures = 0;
+
+static void expect(bool condition, const char* what)
+{
+    if(condition)
+        return;
+
+    std::fprintf(stderr, "%s\n", what);
+    failures++;
+}
+
+int main()
+{
+    ManualClock clock;
+    StaticUserManager<4, 16, 16, 16> userManager;
+    StaticSessionManager<4> sessionManager(clock);
+    StaticLoginThrottle<8> throttle(clock);
+    Authentication authentication(userManager, sessionManager);
+    authentication.setLoginThrottle(throttle);
+
+    LoginThrottle::Policy policy;
+    throttle.setPolicy(policy);
+
+    expect(userManager.createUser(Permission::Observer, "valid", "password").has_value(), "the valid user wasn't created");
+    expect(userManager.createUser(Permission::Observer, "tracked", "password").has_value(), "the tracked user wasn't created");
+
+    // One entry fails below the block, the rest of the table is taken by other usernames.
+    expect(!authentication.authenticate("tracked", "wrong"), "a wrong password was accepted");
+    for(int index = 0; index < 7; index++)
+        expect(!authentication.authenticate("attacker" + std::to_string(index), "wrong"), "an unknown user logged in");
+
+    expect(authentication.authenticate("valid", "password").has_value(), "a valid user was throttled because the table is full");
+    expect(authentication.authenticate("tracked", "password").has_value(), "a user with an entry was throttled");
+
+    // The success freed the entry of the tracked user, another username takes it.
+    expect(!authentication.authenticate("attacker7", "wrong"), "an unknown user logged in");
+
+    // Usernames that don't fit share the overflow entry, so guessing with them is still throttled.
+    for(int index = 0; index <= policy.freeAttempts; index++)
+        (void)authentication.authenticate("overflow" + std::to_string(index), "wrong");
+
+    auto throttled = authentication.authenticate("overflow", "wrong");
+    expect(!throttled && throttled.error() == AuthenticationError::Throttled, "the failures of usernames without an entry weren't throttled");
+    expect(throttle.getBlockedSeconds("valid", std::nullopt) > 0, "the overflow block doesn't apply to usernames without an entry");
+    expect(throttle.getBlockedSeconds("attacker0", std::nullopt) == 0, "the overflow block applies to usernames with an entry");
+
+    // The overflow entry backs off like any other, it doesn't keep the usernames out until the failures are forgotten.
+    clock.time += throttle.getBlockedSeconds("valid", std::nullopt);
+    expect(authentication.authenticate("valid", "password").has_value(), "a valid user was still throttled after the overflow block");
+
+    std::printf("%zu failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
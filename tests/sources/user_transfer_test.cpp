@@ -0,0 +1,72 @@
+#include "user_transfer.hpp"
+#include "journal_storage.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+// Exports the users of one device and imports them into another, in both formats.
+// A user imported back into the device it came from keeps its password, and a user
+// whose id is held by a different user on the other device gets the default one
+// instead of the password of that user.
+
+using Manager = StaticUserManager<8, 16, 16, 16>;
+using Format = UserTransfer::Format;
+
+static constexpr std::string_view DefaultPassword = "default";
+
+static size_t failures = 0;
+
+static void expect(bool condition, const char* format, const char* what)
+{
+    if(condition)
+        return;
+
+    std::fprintf(stderr, "%s: %s\n", format, what);
+    failures++;
+}
+
+static bool hasUser(const UserManager& userManager, User::IdType id, std::string_view username, std::string_view password)
+{
+    auto user = userManager.getUser(id);
+    return user && (*user)->getUsername() == username && (*user)->getPassword() == password;
+}
+
+static void runTransfer(Format format, const char* name)
+{
+    Manager deviceA;
+    Manager deviceB;
+    expect(deviceA.restoreUser(3, Permission::Observer, "alice", "alicepass", "Alice").has_value(), name, "alice wasn't created");
+    expect(deviceA.restoreUser(4, Permission::Maintenance, "carol", "carolpass", "Carol").has_value(), name, "carol wasn't created");
+    expect(deviceB.restoreUser(3, Permission::Superuser, "bob", "bobpass", "Bob").has_value(), name, "bob wasn't created");
+    expect(deviceB.restoreUser(4, Permission::Observer, "carol", "carolpass", "").has_value(), name, "carol wasn't created");
+
+    std::vector<uint8_t> buffer(4096);
+    MemoryJournalStorage storage(buffer);
+    expect(UserTransfer::exportUsers(deviceA, storage, format).has_value(), name, "the export failed");
+
+    // Into the device the users came from: nothing changes.
+    auto summary = UserTransfer::importUsers(deviceA, storage, format, DefaultPassword);
+    expect(summary && summary->imported == 2 && summary->defaultPasswords == 0, name, "importing back counted the wrong users");
+    expect(hasUser(deviceA, 3, "alice", "alicepass"), name, "alice lost the password importing back");
+
+    // Into another device, where the id of alice belongs to bob.
+    summary = UserTransfer::importUsers(deviceB, storage, format, DefaultPassword);
+    expect(summary && summary->imported == 2 && summary->defaultPasswords == 1, name, "importing into another device counted the wrong users");
+    expect(hasUser(deviceB, 3, "alice", DefaultPassword), name, "alice took the password of the user that had the same id");
+    expect(!deviceB.getUser("bob"), name, "bob wasn't replaced by alice");
+    expect(hasUser(deviceB, 4, "carol", "carolpass"), name, "carol lost the password on the other device");
+
+    auto carol = deviceB.getUser(4);
+    expect(carol && (*carol)->getName() == "Carol" && (*carol)->getPermission() == Permission::Maintenance, name, "carol wasn't updated");
+}
+
+int main()
+{
+    runTransfer(Format::Csv, "CSV");
+    runTransfer(Format::Binary, "binary");
+
+    std::printf("%zu failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
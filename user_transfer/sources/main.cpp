@@ -0,0 +1,174 @@
+#include "persistent_user_manager.hpp"
+#include "journal_storage.hpp"
+#include "user_transfer.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string_view>
+
+static constexpr const char* PasswordVariable = "USER_TRANSFER_PASSWORD";
+
+static void printUsage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s export|import [OPTION VALUE]...\n"
+        "  --store PATH      User file of a persistent user manager, created if it doesn't exist. Required.\n"
+        "  --file PATH       CSV or binary file exported to or imported from. Required.\n"
+        "  --users N         Users of the user file. 64 by default.\n"
+        "  --sizes U:P:N     Sizes of the username, password and name of the user file. 32:32:32 by default.\n"
+        "  --format F        csv or binary. csv by default.\n"
+        "Imported users without a password get a default one unless the file has a user with the same\n"
+        "id and username, taken from the %s environment variable or else from the first line\n"
+        "of the standard input.\n",
+        program, PasswordVariable);
+}
+
+// Kept out of the arguments, which any user of the system can read while the tool runs.
+static bool readDefaultPassword(std::array<char, UserTransfer::MaxStringSize + 2>& buffer, std::string_view& password)
+{
+    if(const char* variable = std::getenv(PasswordVariable))
+    {
+        password = variable;
+        return !password.empty();
+    }
+
+    if(!std::fgets(buffer.data(), buffer.size(), stdin))
+        return false;
+
+    password = buffer.data();
+    if(!password.empty() && password.back() == '\n')
+        password.remove_suffix(1);
+    if(!password.empty() && password.back() == '\r')
+        password.remove_suffix(1);
+
+    return !password.empty() && password.size() <= UserTransfer::MaxStringSize;
+}
+
+static bool parseSizes(const char* argument, std::array<size_t, 3>& sizes)
+{
+    for(size_t index = 0; index < sizes.size(); index++)
+    {
+        char* end;
+        unsigned long size = std::strtoul(argument, &end, 10);
+        bool last = index + 1 == sizes.size();
+        if(end == argument || size == 0 || size > UINT16_MAX || *end != (last ? '\0' : ':'))
+            return false;
+
+        sizes[index] = size;
+        argument = end + 1;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::string_view command = argv[1];
+    const char* storePath = nullptr;
+    const char* filePath = nullptr;
+    unsigned long users = 64;
+    std::array<size_t, 3> sizes{32, 32, 32};
+    UserTransfer::Format format = UserTransfer::Format::Csv;
+
+    bool valid = command == "export" || command == "import";
+    for(int i = 2; valid && i < argc; i++)
+    {
+        std::string_view option = argv[i];
+        if(i + 1 >= argc)
+        {
+            valid = false;
+            break;
+        }
+
+        const char* argument = argv[++i];
+        std::string_view value = argument;
+
+        if(option == "--store")
+            storePath = argument;
+        else if(option == "--file")
+            filePath = argument;
+        else if(option == "--sizes")
+            valid = parseSizes(argument, sizes);
+        else if(option == "--format" && (value == "csv" || value == "binary"))
+            format = value == "csv" ? UserTransfer::Format::Csv : UserTransfer::Format::Binary;
+        else if(option == "--users")
+        {
+            char* end;
+            users = std::strtoul(argument, &end, 10);
+            valid = *argument && !*end && users > 0 && users <= UINT16_MAX;
+        }
+        else
+            valid = false;
+    }
+
+    if(!valid || !storePath || !filePath)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::array<char, UserTransfer::MaxStringSize + 2> passwordBuffer;
+    std::string_view password;
+    if(command == "import" && !readDefaultPassword(passwordBuffer, password))
+    {
+        std::fprintf(stderr, "No default password of at most %zu characters in %s or on the standard input\n", UserTransfer::MaxStringSize, PasswordVariable);
+        return EXIT_FAILURE;
+    }
+
+    // The size of the user file is only known at run time, so its tables are allocated here.
+    std::vector<PersistentUser> usersStorage(users);
+    std::vector<User*> usersPointers(users);
+    std::vector<User::IdType> ids(users);
+    std::vector<Permission> permissions(users);
+    std::vector<UserManager::SlotState> states(users);
+    std::vector<uint32_t> usernameHashes(users);
+    for(size_t i = 0; i < users; i++)
+        usersPointers[i] = &usersStorage[i];
+
+    PersistentUserManager userManager(usersPointers, ids, permissions, states, usernameHashes, sizes[0], sizes[1], sizes[2]);
+    if(!userManager.open(storePath))
+    {
+        std::fprintf(stderr, "Couldn't open the user file %s\n", storePath);
+        return EXIT_FAILURE;
+    }
+
+    FileJournalStorage file;
+    if(!file.open(filePath))
+    {
+        std::fprintf(stderr, "Couldn't open %s\n", filePath);
+        return EXIT_FAILURE;
+    }
+
+    if(command == "export")
+    {
+        ResultVoid exported = file.truncate(0);
+        if(exported)
+            exported = UserTransfer::exportUsers(userManager, file, format);
+        if(exported)
+            exported = file.sync();
+        if(!exported)
+        {
+            std::fprintf(stderr, "Export failed with error %d\n", static_cast<int>(exported.error()));
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    auto imported = UserTransfer::importUsers(userManager, file, format, password);
+    if(!imported)
+    {
+        std::fprintf(stderr, "Import failed with error %d\n", static_cast<int>(imported.error()));
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%zu users imported, %zu got the default password\n", imported->imported, imported->defaultPasswords);
+    return EXIT_SUCCESS;
+}